@@ -27,21 +27,20 @@
 #include <sys/cdefs.h>
 __FBSDID("$FreeBSD$");
 
-#include "opt_bus.h"
-
 #include <sys/param.h>
-#include <sys/bus.h>
-#include <sys/lock.h>
-#include <sys/resource.h>
 #include <sys/systm.h>
-#include <sys/rman.h>
+#include <sys/bus.h>
 #include <sys/kernel.h>
 #include <sys/module.h>
+#include <sys/rman.h>
+#include <sys/malloc.h>
+#include <sys/lock.h>
 #include <sys/mutex.h>
-#include <sys/endian.h>
-#include <sys/sema.h>
+#include <sys/callout.h>
+#include <sys/sysctl.h>
 #include <sys/taskqueue.h>
-#include <vm/uma.h>
+#include <sys/time.h>
+#include <sys/ata.h>
 #include <machine/bus.h>
 #include <machine/resource.h>
 
@@ -49,44 +48,41 @@ __FBSDID("$FreeBSD$");
 #include <cam/cam_ccb.h>
 #include <cam/cam_sim.h>
 #include <cam/cam_xpt_sim.h>
-#include <cam/cam_debug.h>
 
-#include <sys/ata.h>
-#include <dev/ata/ata-all.h>
+#include <dev/ahci/ahci.h>
+#include <dev/ahci/ahci_core.h>
 #include <dev/ofw/ofw_bus.h>
 #include <dev/ofw/ofw_bus_subr.h>
+#include <dev/fdt/fdt_common.h>
 
-#include "ata_if.h"
+#include "a10_clk.h"
 
-#define SATA_CHAN_NUM			1
-
-/* Identification section. */
-struct a10_ahci_softc {
-	device_t		sc_dev;
-	unsigned int		sc_version;
-	struct resource		*sc_mem_res;
-	bus_space_tag_t		sc_mem_res_bustag;
-	bus_space_handle_t	sc_mem_res_bushdl;
-	struct resource		*sc_irq_res;
-	void			*sc_irq_cookiep;
-        struct {
-		void	(*function)(void *);
-		void	*argument;
-	} sc_interrupt[SATA_CHAN_NUM];
-};
-
-
-#define	ahci_readl(base,offset)		\
-	(*((volatile uint32_t *)((base)+(offset))))
-#define ahci_writel(base,offset,val)	\
-	(*((volatile uint32_t *)((base)+(offset))) = (val))
-
-#define SW_AHCI_BASE			0xe1c18000
+/*
+ * Allwinner A10 front-end for the generic ahci(4) driver.  The SoC has a
+ * single port DesignWare AHCI core; all we do here is bring up its PHY
+ * and hand the controller to the ahci core, which provides NCQ and the
+ * CAM glue.
+ *
+ * Disks attach as ada(4).  It turns BIO_DELETE into DATA SET MANAGEMENT
+ * TRIM when the drive supports it, merging queued deletes into as many
+ * ranges as the drive accepts per command (max_dsm_blocks * 64).  DSM
+ * is an ordinary non-queued DMA command to the core, so nothing here
+ * limits it; see the kern.cam.ada.N.delete_method sysctl.
+ *
+ * The core entry points are exported by dev/ahci/ahci_core.h and ahci.c
+ * is built for "ahci" without "pci"; ahci_split.diff makes both changes.
+ */
 
 #define SW_AHCI_BISTAFR_OFFSET		0x00A0
 #define SW_AHCI_BISTCR_OFFSET		0x00A4
+#define  SW_AHCI_BISTCR_ERREN		(1 << 6)	/* count errors */
+#define  SW_AHCI_BISTCR_NEALB		(1 << 16)	/* near-end loopback */
+#define  SW_AHCI_BISTCR_CNTCLR		(1 << 17)	/* clear counters */
 #define SW_AHCI_BISTFCTR_OFFSET		0x00A8
 #define SW_AHCI_BISTSR_OFFSET		0x00AC
+#define  SW_AHCI_BISTSR_FRAMERR		0x0000ffff
+#define  SW_AHCI_BISTSR_BRSTERR		0x00ff0000
+#define  SW_AHCI_BISTSR_BRSTERR_SHIFT	16
 #define SW_AHCI_BISTDECR_OFFSET		0x00B0
 #define SW_AHCI_DIAGNR_OFFSET		0x00B4
 #define SW_AHCI_DIAGNR1_OFFSET		0x00B8
@@ -104,373 +100,1512 @@ struct a10_ahci_softc {
 #define SW_AHCI_RWCR_OFFSET		0x00FC
 
 #define SW_AHCI_P0DMACR_OFFSET		0x0170
+#define  SW_AHCI_P0DMACR_TXTS_SHIFT	0	/* TX transaction size */
+#define  SW_AHCI_P0DMACR_RXTS_SHIFT	4	/* RX transaction size */
+#define  SW_AHCI_P0DMACR_TXABL_SHIFT	8	/* TX AHB burst limit */
+#define  SW_AHCI_P0DMACR_RXABL_SHIFT	12	/* RX AHB burst limit */
+#define  SW_AHCI_P0DMACR_MASK		0xffff
 #define SW_AHCI_P0PHYCR_OFFSET		0x0178
 #define SW_AHCI_P0PHYSR_OFFSET		0x017C
 
-#define SW_AHCI_ACCESS_LOCK(base,x)	\
-	(*((volatile uint32_t *)((base)+SW_AHCI_RWCR_OFFSET)) = (x))
+#define A10_AHCI_READ_4(sc, reg)	\
+	ATA_INL((sc)->sc_ctlr.r_mem, (reg))
+#define A10_AHCI_WRITE_4(sc, reg, val)	\
+	ATA_OUTL((sc)->sc_ctlr.r_mem, (reg), (val))
+
+#define SW_AHCI_ACCESS_LOCK(sc, x)	\
+	A10_AHCI_WRITE_4((sc), SW_AHCI_RWCR_OFFSET, (x))
+
+/* The A10 reports no implemented ports, it has exactly one. */
+#define A10_AHCI_PI			0x1
+
+#define A10_AHCI_PHY_SETTLE_US		100
+#define A10_AHCI_PHY_TIMEOUT_MS		100
+/* PHYCS0R power state field, 2 once the PHY is powered up */
+#define A10_AHCI_PHY_STATE(r)		(((r) >> 28) & 0x7)
+#define A10_AHCI_BIST_MS		100
+
+/* Link power management (ALPM) policy */
+#define A10_AHCI_ALPM_OFF		0
+#define A10_AHCI_ALPM_PARTIAL		1
+#define A10_AHCI_ALPM_SLUMBER		2
+#define A10_AHCI_ALPM_IDLE_MS		100
+#define A10_AHCI_ALPM_SLUMBER_MS	2000
+
+/* Link states, indexes sc_alpm_time[] */
+#define A10_AHCI_LINK_ACTIVE		0
+#define A10_AHCI_LINK_PARTIAL		1
+#define A10_AHCI_LINK_SLUMBER		2
+#define A10_AHCI_LINK_NSTATES		3
+
+/*
+ * Port DMA transaction sizes and AHB burst limits.  The reset value
+ * splits transfers into small AHB transactions; this is what the vendor
+ * kernel programs for streaming throughput.
+ */
+#define A10_AHCI_DMACR_DEFAULT		0x4433
+/* Time allowed for the port DMA engine to stop (PxCMD.CR). */
+#define A10_AHCI_STOP_TIMEOUT_MS	500
+
+/* Command completion coalescing defaults */
+#define A10_AHCI_CCC_TIME_MS		1
+#define A10_AHCI_CCC_COUNT		8
 
-#define INTC_IRQNO_AHCI			56
+struct a10_ahci_softc {
+	/* Must be first, the ahci core uses it as its softc. */
+	struct ahci_controller	sc_ctlr;
+	device_t		sc_dev;
+	struct intr_config_hook	sc_hook;
+	int			sc_hook_pending;
+	int			sc_attached;	/* ahci core attached */
+	int			sc_clk_on;	/* SATA clocks ungated */
 
-#define CCMU_PLL6_VBASE			0xe1c20028
+	/*
+	 * ALPM, driven from the interrupt path and a callout holding the
+	 * channel lock that is only armed while a transition is due.
+	 */
+	struct ahci_channel	*sc_ch;
+	struct callout		sc_alpm_callout;
+	int			sc_alpm;
+	int			sc_alpm_idle_ms;
+	int			sc_alpm_slumber_ms;
+	int			sc_alpm_slumber_next;	/* partial, woken */
+	int			sc_alpm_settle;	/* next run only looks */
+	int			sc_suspended;
+	int			sc_link;
+	struct bintime		sc_link_since;
+	struct bintime		sc_alpm_time[A10_AHCI_LINK_NSTATES];
+	uint64_t		sc_alpm_partial;
+	uint64_t		sc_alpm_slumber;
+	uint64_t		sc_alpm_wakes;
+	/* Wakes we ask for, timed until their PhyRdy change is in */
+	struct bintime		sc_alpm_wake_start;
+	int			sc_alpm_wake_timing;
+	uint64_t		sc_alpm_wake_timed;
+	uint64_t		sc_alpm_wake_us;
+	uint64_t		sc_alpm_wake_us_max;
 
+	/*
+	 * Hot-plug is left to the core's PhyRdy change interrupt; a filter
+	 * in front of it drops the changes our own link power transitions
+	 * cause.  sc_pm_window is set from just before such a transition
+	 * until the link is seen active again.
+	 */
+	void			*sc_intrhand;
+	volatile int		sc_pm_window;
+	int			sc_online;
+	uint64_t		sc_link_up;
+	uint64_t		sc_link_down;
+
+	/* PHY diagnostics */
+	uint64_t		sc_serr[32];	/* per SError bit */
+	struct mtx		sc_stat_mtx;	/* spin, the filter's counters */
+	int			sc_bist_running;
+	uint32_t		sc_bist_fis;
+	uint32_t		sc_bist_frame_errors;
+	uint32_t		sc_bist_burst_errors;
+	uint32_t		sc_bist_dword_errors;
+
+	int			sc_ccc_count;
+
+	uint32_t		sc_dmacr;
+	int			sc_dmacr_pending;
+	struct task		sc_dmacr_task;
+};
 
-/* Controller functions */
 static int	a10_ahci_probe(device_t dev);
 static int	a10_ahci_attach(device_t dev);
 static int	a10_ahci_detach(device_t dev);
-static void	a10_ahci_intr(void*);
-static struct resource * a10_ahci_alloc_resource(device_t dev, device_t child,
-    int type, int *rid, u_long start, u_long end, u_long count, u_int flags);
-static int	a10_ahci_release_resource(device_t dev, device_t child, int type,
-    int rid, struct resource *r);
-static int	a10_ahci_setup_intr(device_t dev, device_t child,
-    struct resource *irq, int flags, driver_filter_t *filt,
-    driver_intr_t *function, void *argument, void **cookiep);
-static int	a10_ahci_teardown_intr(device_t dev, device_t child,
-    struct resource *irq, void *cookie);
-
+static int	a10_ahci_suspend(device_t dev);
+static int	a10_ahci_resume(device_t dev);
+static int	a10_ahci_phy_init(struct a10_ahci_softc *sc);
+static void	a10_ahci_start(void *arg);
+static void	a10_ahci_alpm_init(struct a10_ahci_softc *sc);
+static void	a10_ahci_alpm_timeout(void *arg);
+static void	a10_ahci_dmacr_apply(struct a10_ahci_softc *sc);
+
+/*
+ * Default link power policy: 0 keeps the link active, 1 allows partial,
+ * 2 allows partial and then slumber after a longer idle period.  Partial
+ * wakes in microseconds, slumber can cost the first I/O milliseconds.
+ */
+static int a10_ahci_alpm_default = A10_AHCI_ALPM_PARTIAL;
+TUNABLE_INT("hw.a10_ahci.alpm", &a10_ahci_alpm_default);
+
+static SYSCTL_NODE(_hw, OID_AUTO, a10_ahci, CTLFLAG_RD, 0,
+    "A10 AHCI");
+SYSCTL_INT(_hw_a10_ahci, OID_AUTO, alpm, CTLFLAG_RDTUN,
+    &a10_ahci_alpm_default, 0, "Default link power management policy");
+
+/*
+ * Command completion coalescing: one interrupt per ccc_count completed
+ * commands or ccc_time milliseconds after the first of them, whichever
+ * comes first.  This trades up to ccc_time of completion latency at low
+ * queue depths for far fewer interrupts under NCQ load.  A zero
+ * ccc_time leaves one interrupt per command.  An explicit
+ * hint.ahci.N.ccc overrides ccc_time.
+ */
+static int a10_ahci_ccc_time = A10_AHCI_CCC_TIME_MS;
+TUNABLE_INT("hw.a10_ahci.ccc_time", &a10_ahci_ccc_time);
+static int a10_ahci_ccc_count = A10_AHCI_CCC_COUNT;
+TUNABLE_INT("hw.a10_ahci.ccc_count", &a10_ahci_ccc_count);
+
+SYSCTL_INT(_hw_a10_ahci, OID_AUTO, ccc_time, CTLFLAG_RDTUN,
+    &a10_ahci_ccc_time, 0, "Default coalescing timeout (ms)");
+SYSCTL_INT(_hw_a10_ahci, OID_AUTO, ccc_count, CTLFLAG_RDTUN,
+    &a10_ahci_ccc_count, 0, "Default coalescing command count");
+
+/*
+ * Port multiplier support.  The controller advertises PMP, but cannot
+ * soft reset a directly attached disk once PMP is enabled, so it stays
+ * off unless a multiplier is known to be connected.  FIS-based switching
+ * is then used by the core if CAP.FBSS is set; otherwise it falls back
+ * to command-based switching, one drive at a time.
+ */
+static int a10_ahci_pmp = 0;
+TUNABLE_INT("hw.a10_ahci.pmp", &a10_ahci_pmp);
+SYSCTL_INT(_hw_a10_ahci, OID_AUTO, pmp, CTLFLAG_RDTUN,
+    &a10_ahci_pmp, 0, "Enable port multiplier support");
 
 static int
 a10_ahci_probe(device_t dev)
 {
-	if (!ofw_bus_is_compatible(dev, "a10,ahci"))
+
+	if (!ofw_bus_is_compatible(dev, "allwinner,ahci"))
 		return (ENXIO);
 
 	device_set_desc(dev, "Allwinner Integrated AHCI Controller");
-	return (0);
+	return (BUS_PROBE_DEFAULT);
 }
 
+/*
+ * The SATA clocks come from the PLL6 SATA output and the CCM SATA/AHB
+ * gates; turning them off loses the PHY setup, so every ungate has to be
+ * followed by a10_ahci_phy_init().
+ */
 static int
-a10_ahci_attach(device_t dev)
+a10_ahci_clk_enable(struct a10_ahci_softc *sc)
 {
-	struct a10_ahci_softc *sc;
-	int mem_id, irq_id, error, i;
-	device_t child;
-	uint32_t tmp;
-	uint32_t timeout_val = 0x100000;
-	uint32_t timeout = timeout_val;
+	int error;
 
-	sc = device_get_softc(dev);
-	sc->sc_dev = dev;
-	mem_id = 0;
-	irq_id = 0;
+	if (sc->sc_clk_on)
+		return (0);
+	error = a10_clk_sata_activate();
+	if (error != 0) {
+		device_printf(sc->sc_dev, "could not enable SATA clock\n");
+		return (error);
+	}
+	DELAY(A10_AHCI_PHY_SETTLE_US);
+	sc->sc_clk_on = 1;
 
-	printf("---------- 10 ------------\n");
+	return (0);
+}
 
-	/*Enable SATA Clock in SATA PLL*/
-	ahci_writel(CCMU_PLL6_VBASE, 0, ahci_readl(CCMU_PLL6_VBASE, 0)|(0x1<<14));
+static void
+a10_ahci_clk_disable(struct a10_ahci_softc *sc)
+{
 
-	for(tmp=0; tmp<0x1000; tmp++);
+	if (!sc->sc_clk_on)
+		return;
+	a10_clk_sata_deactivate();
+	sc->sc_clk_on = 0;
+}
 
-	/* phy init */
+/*
+ * Wait up to timeout_ms for (reg & mask) == val.  Before interrupts are
+ * enabled we have to spin; afterwards sleep a tick at a time so the rest
+ * of the boot can make progress while the PHY comes up.
+ */
+static int
+a10_ahci_phy_wait(struct a10_ahci_softc *sc, uint32_t reg, uint32_t mask,
+    uint32_t val, int timeout_ms)
+{
+	int elapsed, step;
+
+	step = cold ? 1 : max(1, 1000 / hz);
+	for (elapsed = 0; elapsed <= timeout_ms; elapsed += step) {
+		if ((A10_AHCI_READ_4(sc, reg) & mask) == val)
+			return (0);
+		if (cold)
+			DELAY(step * 1000);
+		else
+			pause("a10phy", 1);
+	}
 
-	printf("---------- 10 next ------------\n");
+	return (ETIMEDOUT);
+}
 
-//	volatile uint32_t *base = (uint32_t *) 0xe1c180fc;
-//	*base = 0;
+static int
+a10_ahci_phy_init(struct a10_ahci_softc *sc)
+{
+	uint32_t tmp;
+	int error;
+
+	SW_AHCI_ACCESS_LOCK(sc, 0);
+
+	tmp = A10_AHCI_READ_4(sc, SW_AHCI_PHYCS1R_OFFSET);
+	tmp |= (0x1 << 19);
+	A10_AHCI_WRITE_4(sc, SW_AHCI_PHYCS1R_OFFSET, tmp);
+
+	tmp = A10_AHCI_READ_4(sc, SW_AHCI_PHYCS0R_OFFSET);
+	tmp |= 0x1 << 23;
+	tmp |= 0x1 << 18;
+	tmp &= ~(0x7 << 24);
+	tmp |= 0x5 << 24;
+	A10_AHCI_WRITE_4(sc, SW_AHCI_PHYCS0R_OFFSET, tmp);
+
+	tmp = A10_AHCI_READ_4(sc, SW_AHCI_PHYCS1R_OFFSET);
+	tmp &= ~(0x3 << 16);
+	tmp |= (0x2 << 16);
+	tmp &= ~(0x1f << 8);
+	tmp |= (6 << 8);
+	tmp &= ~(0x3 << 6);
+	tmp |= (2 << 6);
+	A10_AHCI_WRITE_4(sc, SW_AHCI_PHYCS1R_OFFSET, tmp);
+
+	tmp = A10_AHCI_READ_4(sc, SW_AHCI_PHYCS1R_OFFSET);
+	tmp |= (0x1 << 28);
+	tmp |= (0x1 << 15);
+	A10_AHCI_WRITE_4(sc, SW_AHCI_PHYCS1R_OFFSET, tmp);
+
+	tmp = A10_AHCI_READ_4(sc, SW_AHCI_PHYCS1R_OFFSET);
+	tmp &= ~(0x1 << 19);
+	A10_AHCI_WRITE_4(sc, SW_AHCI_PHYCS1R_OFFSET, tmp);
+
+	tmp = A10_AHCI_READ_4(sc, SW_AHCI_PHYCS0R_OFFSET);
+	tmp &= ~(0x7 << 20);
+	tmp |= (0x03 << 20);
+	A10_AHCI_WRITE_4(sc, SW_AHCI_PHYCS0R_OFFSET, tmp);
+
+	tmp = A10_AHCI_READ_4(sc, SW_AHCI_PHYCS2R_OFFSET);
+	tmp &= ~(0x1f << 5);
+	tmp |= (0x19 << 5);
+	A10_AHCI_WRITE_4(sc, SW_AHCI_PHYCS2R_OFFSET, tmp);
+
+	DELAY(A10_AHCI_PHY_SETTLE_US);
+
+	/* Power up the PHY and wait for it to report ready */
+	tmp = A10_AHCI_READ_4(sc, SW_AHCI_PHYCS0R_OFFSET);
+	tmp |= 0x1 << 19;
+	A10_AHCI_WRITE_4(sc, SW_AHCI_PHYCS0R_OFFSET, tmp);
+
+	error = a10_ahci_phy_wait(sc, SW_AHCI_PHYCS0R_OFFSET, 0x7 << 28,
+	    0x2 << 28, A10_AHCI_PHY_TIMEOUT_MS);
+	if (error != 0) {
+		device_printf(sc->sc_dev, "PHY power up timed out\n");
+		goto out;
+	}
 
-	SW_AHCI_ACCESS_LOCK(SW_AHCI_BASE, 0);
+	/* Start calibration, the bit self-clears when done */
+	tmp = A10_AHCI_READ_4(sc, SW_AHCI_PHYCS2R_OFFSET);
+	tmp |= 0x1 << 24;
+	A10_AHCI_WRITE_4(sc, SW_AHCI_PHYCS2R_OFFSET, tmp);
 
-	printf("---------- 100 ------------\n");
+	error = a10_ahci_phy_wait(sc, SW_AHCI_PHYCS2R_OFFSET, 0x1 << 24, 0,
+	    A10_AHCI_PHY_TIMEOUT_MS);
+	if (error != 0) {
+		device_printf(sc->sc_dev, "PHY calibration timed out\n");
+		goto out;
+	}
 
-	tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS1R_OFFSET);
-	tmp |= (0x1<<19);
-	ahci_writel(SW_AHCI_BASE, SW_AHCI_PHYCS1R_OFFSET, tmp);
+	DELAY(A10_AHCI_PHY_SETTLE_US);
 
-	printf("---------- 1001 ------------\n");
+out:
+	SW_AHCI_ACCESS_LOCK(sc, 0x07);
 
-	tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS0R_OFFSET);
-	tmp |= 0x1<<23;
-	tmp |= 0x1<<18;
-	tmp &= ~(0x7<<24);
-	tmp |= 0x5<<24;
-	ahci_writel(SW_AHCI_BASE, SW_AHCI_PHYCS0R_OFFSET, tmp);
+	return (error);
+}
 
-	printf("---------- 1002 ------------\n");
+static void
+a10_ahci_alpm_set_link(struct a10_ahci_softc *sc, int link)
+{
+	struct bintime bt, now;
+
+	if (sc->sc_link == link)
+		return;
+	binuptime(&now);
+	bt = now;
+	bintime_sub(&bt, &sc->sc_link_since);
+	bintime_add(&sc->sc_alpm_time[sc->sc_link], &bt);
+	sc->sc_link_since = now;
+	if (sc->sc_link != A10_AHCI_LINK_ACTIVE &&
+	    link == A10_AHCI_LINK_ACTIVE)
+		sc->sc_alpm_wakes++;
+	else if (link == A10_AHCI_LINK_PARTIAL)
+		sc->sc_alpm_partial++;
+	else if (link == A10_AHCI_LINK_SLUMBER)
+		sc->sc_alpm_slumber++;
+	sc->sc_link = link;
+}
 
-	tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS1R_OFFSET);
-	tmp &= ~(0x3<<16);
-	tmp |= (0x2<<16);
-	tmp &= ~(0x1f<<8);
-	tmp |= (6<<8);
-	tmp &= ~(0x3<<6);
-	tmp |= (2<<6);
-	ahci_writel(SW_AHCI_BASE, SW_AHCI_PHYCS1R_OFFSET, tmp);
+static void
+a10_ahci_alpm_icc(struct a10_ahci_softc *sc, uint32_t icc)
+{
+	struct ahci_channel *ch;
+	uint32_t cmd;
+
+	ch = sc->sc_ch;
+	cmd = ATA_INL(ch->r_mem, AHCI_P_CMD);
+	cmd &= ~AHCI_P_CMD_ICC_MASK;
+	cmd |= icc;
+	ATA_OUTL(ch->r_mem, AHCI_P_CMD, cmd);
+}
 
-	printf("---------- 1003 ------------\n");
+/*
+ * Ask for the link to come back to active.  The request is timestamped
+ * and a10_ahci_alpm_update() records the latency once the link reads
+ * active with the wake up's PhyRdy change in.  Wakes the HBA starts by
+ * itself when the core issues a command are counted in sc_alpm_wakes
+ * but cannot be timed, as the request never passes through here.
+ */
+static void
+a10_ahci_alpm_wake(struct a10_ahci_softc *sc)
+{
 
-	tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS1R_OFFSET);
-	tmp |= (0x1<<28);
-	tmp |= (0x1<<15);
-	ahci_writel(SW_AHCI_BASE, SW_AHCI_PHYCS1R_OFFSET, tmp);
+	sc->sc_pm_window = 1;
+	binuptime(&sc->sc_alpm_wake_start);
+	sc->sc_alpm_wake_timing = 1;
+	a10_ahci_alpm_icc(sc, AHCI_P_CMD_ACTIVE);
+}
 
-	printf("---------- 1004 ------------\n");
+static void
+a10_ahci_alpm_wake_done(struct a10_ahci_softc *sc)
+{
+	struct bintime bt;
+	uint64_t us;
+
+	binuptime(&bt);
+	bintime_sub(&bt, &sc->sc_alpm_wake_start);
+	us = (uint64_t)bt.sec * 1000000 +
+	    (((uint64_t)1000000 * (uint32_t)(bt.frac >> 32)) >> 32);
+	sc->sc_alpm_wake_timed++;
+	sc->sc_alpm_wake_us += us;
+	if (us > sc->sc_alpm_wake_us_max)
+		sc->sc_alpm_wake_us_max = us;
+	sc->sc_alpm_wake_timing = 0;
+}
 
-	tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS1R_OFFSET);
-	tmp &= ~(0x1<<19);
-	ahci_writel(SW_AHCI_BASE, SW_AHCI_PHYCS1R_OFFSET, tmp);
+/*
+ * At pm_level 0 the core forbids partial and slumber in SControl on every
+ * port reset, so lift that before asking for a transition, and put it
+ * back when ALPM is turned off.  Called with the channel lock held.
+ */
+static void
+a10_ahci_alpm_sctl(struct a10_ahci_softc *sc, int allow)
+{
+	struct ahci_channel *ch;
+	uint32_t dis, sctl;
+
+	ch = sc->sc_ch;
+	if (ch->pm_level != 0)
+		return;
+	dis = ATA_SC_IPM_DIS_PARTIAL | ATA_SC_IPM_DIS_SLUMBER;
+	sctl = ATA_INL(ch->r_mem, AHCI_P_SCTL);
+	if ((sctl & dis) == (allow ? 0 : dis))
+		return;
+	sctl &= ~(dis | ATA_SC_DET_MASK);
+	if (!allow)
+		sctl |= dis;
+	ATA_OUTL(ch->r_mem, AHCI_P_SCTL, sctl);
+}
 
-	printf("---------- 1005 ------------\n");
+/*
+ * Ask for a partial or slumber transition.  It toggles PhyRdy, so open
+ * the window in which the link filter treats PhyRdy changes as ours.
+ */
+static void
+a10_ahci_alpm_enter(struct a10_ahci_softc *sc, uint32_t icc)
+{
 
-	tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS0R_OFFSET);
-	tmp &= ~(0x7<<20);
-	tmp |= (0x03<<20);
-	ahci_writel(SW_AHCI_BASE, SW_AHCI_PHYCS0R_OFFSET, tmp);
+	a10_ahci_alpm_sctl(sc, 1);
+	sc->sc_pm_window = 1;
+	a10_ahci_alpm_icc(sc, icc);
+}
 
-	printf("---------- 1006 ------------\n");
+static int
+a10_ahci_alpm_busy(struct a10_ahci_softc *sc)
+{
+	struct ahci_channel *ch;
 
-	tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS2R_OFFSET);
-	tmp &= ~(0x1f<<5);
-	tmp |= (0x19<<5);
-	ahci_writel(SW_AHCI_BASE, SW_AHCI_PHYCS2R_OFFSET, tmp);
+	ch = sc->sc_ch;
+	return (ch->numrslots != 0 || ATA_INL(ch->r_mem, AHCI_P_CI) != 0 ||
+	    ATA_INL(ch->r_mem, AHCI_P_SACT) != 0);
+}
 
-	printf("---------- 110 XXX ------------\n");
+/*
+ * Look at the link after an interrupt, one of our transitions or a policy
+ * change, account for the state it is in and decide when the callout
+ * should run next.  The callout is only armed while the port is idle and
+ * a transition is due, so a busy or sleeping port costs no timer at all;
+ * the interrupt handler calls this after every completion, which pushes
+ * the deadline back while I/O keeps coming.  Called with the channel
+ * lock held.
+ */
+static void
+a10_ahci_alpm_update(struct a10_ahci_softc *sc)
+{
+	struct ahci_channel *ch;
+	uint32_t caps, ssts;
+	int link, ms;
+
+	ch = sc->sc_ch;
+	sc->sc_alpm_settle = 0;
+	if (sc->sc_suspended)
+		goto stop;
+
+	ssts = ATA_INL(ch->r_mem, AHCI_P_SSTS);
+	if ((ssts & ATA_SS_DET_MASK) != ATA_SS_DET_PHY_ONLINE) {
+		sc->sc_pm_window = 0;
+		sc->sc_alpm_wake_timing = 0;
+		sc->sc_alpm_slumber_next = 0;
+		a10_ahci_alpm_set_link(sc, A10_AHCI_LINK_ACTIVE);
+		goto stop;
+	}
+	/* The device may also change the link state on its own (DIPM). */
+	switch (ssts & ATA_SS_IPM_MASK) {
+	case ATA_SS_IPM_PARTIAL:
+		link = A10_AHCI_LINK_PARTIAL;
+		break;
+	case ATA_SS_IPM_SLUMBER:
+		link = A10_AHCI_LINK_SLUMBER;
+		break;
+	default:
+		link = A10_AHCI_LINK_ACTIVE;
+		/* Close the window once the wake up's PhyRdy change is in. */
+		if ((ATA_INL(ch->r_mem, AHCI_P_IS) & AHCI_P_IX_PRC) == 0) {
+			sc->sc_pm_window = 0;
+			if (sc->sc_alpm_wake_timing)
+				a10_ahci_alpm_wake_done(sc);
+		}
+		break;
+	}
+	a10_ahci_alpm_set_link(sc, link);
 
-	for(tmp=0; tmp<0x1000; tmp++);
+	if (a10_ahci_alpm_busy(sc)) {
+		sc->sc_alpm_slumber_next = 0;
+		goto stop;
+	}
+	if (sc->sc_dmacr_pending)
+		a10_ahci_dmacr_apply(sc);
+	if (sc->sc_alpm == A10_AHCI_ALPM_OFF || ch->pm_level > 1 ||
+	    sc->sc_bist_running)
+		goto stop;
+
+	caps = sc->sc_ctlr.caps;
+	if (sc->sc_alpm != A10_AHCI_ALPM_SLUMBER ||
+	    (caps & AHCI_CAP_SSC) == 0)
+		sc->sc_alpm_slumber_next = 0;
+	if (link == A10_AHCI_LINK_ACTIVE && sc->sc_alpm_slumber_next)
+		ms = 0;
+	else if (link == A10_AHCI_LINK_ACTIVE && (caps & AHCI_CAP_PSC))
+		ms = sc->sc_alpm_idle_ms;
+	else if (link != A10_AHCI_LINK_SLUMBER &&
+	    sc->sc_alpm == A10_AHCI_ALPM_SLUMBER && (caps & AHCI_CAP_SSC))
+		ms = (link == A10_AHCI_LINK_ACTIVE) ? sc->sc_alpm_slumber_ms :
+		    max(sc->sc_alpm_slumber_ms - sc->sc_alpm_idle_ms, 0);
+	else
+		goto stop;
+	callout_reset(&sc->sc_alpm_callout, max(1, ms * hz / 1000),
+	    a10_ahci_alpm_timeout, sc);
+	return;
+stop:
+	callout_stop(&sc->sc_alpm_callout);
+}
 
-	tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS0R_OFFSET);
-	tmp |= 0x1<<19;
-	ahci_writel(SW_AHCI_BASE, SW_AHCI_PHYCS0R_OFFSET, tmp);
+/*
+ * Host initiated link power management.  The ahci core only has fixed PM
+ * timers (pm_level 4 and 5), so below that we run our own policy: once
+ * the port has had nothing outstanding for alpm_idle_ms the link goes to
+ * partial, and with alpm 2 to slumber after alpm_slumber_ms.  The HBA
+ * brings the link back by itself when the core issues the next command.
+ *
+ * Slumber cannot be entered from partial.  Rather than wait here for the
+ * link to come back to active, ask for it and let the next run, a tick
+ * later, ask for slumber.  Each request is also followed by a one tick
+ * settle run that records the state the link actually ended up in.
+ * Runs with the channel lock held, like the core's own PM callout, so it
+ * cannot race with command issue.
+ */
+static void
+a10_ahci_alpm_timeout(void *arg)
+{
+	struct a10_ahci_softc *sc;
+	struct ahci_channel *ch;
+	uint32_t ssts;
+
+	sc = arg;
+	ch = sc->sc_ch;
+	if (sc->sc_alpm_settle || sc->sc_alpm == A10_AHCI_ALPM_OFF ||
+	    sc->sc_bist_running || a10_ahci_alpm_busy(sc)) {
+		a10_ahci_alpm_update(sc);
+		return;
+	}
 
-	printf("---------- 110 ------------\n");
+	ssts = ATA_INL(ch->r_mem, AHCI_P_SSTS);
+	if ((ssts & ATA_SS_DET_MASK) != ATA_SS_DET_PHY_ONLINE) {
+		a10_ahci_alpm_update(sc);
+		return;
+	}
+	switch (ssts & ATA_SS_IPM_MASK) {
+	case ATA_SS_IPM_ACTIVE:
+		if (sc->sc_alpm_slumber_next ||
+		    (sc->sc_ctlr.caps & AHCI_CAP_PSC) == 0) {
+			sc->sc_alpm_slumber_next = 0;
+			a10_ahci_alpm_enter(sc, AHCI_P_CMD_SLUMBER);
+		} else
+			a10_ahci_alpm_enter(sc, AHCI_P_CMD_PARTIAL);
+		break;
+	case ATA_SS_IPM_PARTIAL:
+		if (sc->sc_alpm != A10_AHCI_ALPM_SLUMBER ||
+		    (sc->sc_ctlr.caps & AHCI_CAP_SSC) == 0) {
+			a10_ahci_alpm_update(sc);
+			return;
+		}
+		sc->sc_alpm_slumber_next = 1;
+		a10_ahci_alpm_wake(sc);
+		break;
+	default:
+		a10_ahci_alpm_update(sc);
+		return;
+	}
+	sc->sc_alpm_settle = 1;
+	callout_reset(&sc->sc_alpm_callout, 1, a10_ahci_alpm_timeout, sc);
+}
 
-	timeout = timeout_val;
-	do{
-		tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS0R_OFFSET);
-		timeout --;
-		if(!timeout) break;
-	}while((tmp&(0x7<<28))!=(0x02<<28));
+/*
+ * Count SError bits as they show up, then clear them so the next
+ * occurrence is counted again.  Recovered CRC, decode and disparity
+ * errors raise no interrupt of their own, so without this a marginal
+ * cable only shows up as lost throughput.  PhyRdy change and exchanged
+ * are left for the core's hot-plug handling; the core does not look at
+ * the other bits.  Only called from the link filter, so the counters
+ * are guarded by the spin mutex sc_stat_mtx.
+ */
+static void
+a10_ahci_serr_sample(struct a10_ahci_softc *sc)
+{
+	uint32_t serr;
+	int bit;
+
+	serr = ATA_INL(sc->sc_ch->r_mem, AHCI_P_SERR);
+	serr &= ~(ATA_SE_PHY_CHANGED | ATA_SE_EXCHANGED);
+	if (serr == 0)
+		return;
+	mtx_lock_spin(&sc->sc_stat_mtx);
+	for (bit = 0; bit < 32; bit++)
+		if (serr & (1U << bit))
+			sc->sc_serr[bit]++;
+	mtx_unlock_spin(&sc->sc_stat_mtx);
+	ATA_OUTL(sc->sc_ch->r_mem, AHCI_P_SERR, serr);
+}
 
-	printf("---------- 1100 ------------\n");
+/*
+ * Runs in interrupt context ahead of the core's handler, which rescans
+ * the bus on any PhyRdy change.  Partial, slumber and the wake up from
+ * them all toggle PhyRdy while the device stays present, so clear such a
+ * change here if DET still reads online and the link is in, or leaving,
+ * a low power state; a real unplug drops DET and is passed on.
+ */
+static int
+a10_ahci_link_filter(void *arg)
+{
+	struct a10_ahci_softc *sc;
+	struct ahci_channel *ch;
+	uint32_t ssts;
+	int online;
+
+	sc = arg;
+	ch = sc->sc_ch;
+	/* During BIST the PHY is looped back and nothing is plugged in. */
+	if (!sc->sc_bist_running)
+		a10_ahci_serr_sample(sc);
+	if ((ATA_INL(ch->r_mem, AHCI_P_IS) & AHCI_P_IX_PRC) == 0)
+		return (FILTER_SCHEDULE_THREAD);
+
+	ssts = ATA_INL(ch->r_mem, AHCI_P_SSTS);
+	online = (ssts & ATA_SS_DET_MASK) == ATA_SS_DET_PHY_ONLINE;
+	if (sc->sc_bist_running || (online && (sc->sc_pm_window ||
+	    (ssts & ATA_SS_IPM_MASK) != ATA_SS_IPM_ACTIVE))) {
+		ATA_OUTL(ch->r_mem, AHCI_P_SERR, ATA_SE_PHY_CHANGED);
+		ATA_OUTL(ch->r_mem, AHCI_P_IS, AHCI_P_IX_PRC);
+		return (FILTER_HANDLED | FILTER_SCHEDULE_THREAD);
+	}
 
-	if(!timeout)
-	{
-		device_printf(dev, "SATA AHCI Phy Power Failed!!\n");
+	if (online != sc->sc_online) {
+		sc->sc_online = online;
+		mtx_lock_spin(&sc->sc_stat_mtx);
+		if (online)
+			sc->sc_link_up++;
+		else
+			sc->sc_link_down++;
+		mtx_unlock_spin(&sc->sc_stat_mtx);
 	}
+	if (!online)
+		sc->sc_pm_window = 0;
 
-	tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS2R_OFFSET);
-	tmp |= 0x1<<24;
-	ahci_writel(SW_AHCI_BASE, SW_AHCI_PHYCS2R_OFFSET, tmp);
+	return (FILTER_SCHEDULE_THREAD);
+}
 
-	printf("---------- 11000 ------------\n");
+/* Runs after the core's handler, once it has retired what completed. */
+static void
+a10_ahci_link_intr(void *arg)
+{
+	struct a10_ahci_softc *sc;
 
-	timeout = timeout_val;
-	do{
-		tmp = ahci_readl(SW_AHCI_BASE, SW_AHCI_PHYCS2R_OFFSET);
-		timeout --;
-		if(!timeout) break;
-	}while(tmp&(0x1<<24));
+	sc = arg;
+	mtx_lock(&sc->sc_ch->mtx);
+	a10_ahci_alpm_update(sc);
+	mtx_unlock(&sc->sc_ch->mtx);
+}
 
-	printf("---------- 111 ------------\n");
+static int
+a10_ahci_alpm_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_ahci_softc *sc;
+	int error, val;
+
+	sc = arg1;
+	val = sc->sc_alpm;
+	error = sysctl_handle_int(oidp, &val, 0, req);
+	if (error != 0 || req->newptr == NULL)
+		return (error);
+	if (val < A10_AHCI_ALPM_OFF || val > A10_AHCI_ALPM_SLUMBER)
+		return (EINVAL);
+	/* Without the link filter every transition would cause a rescan. */
+	if (val != A10_AHCI_ALPM_OFF && sc->sc_intrhand == NULL)
+		return (ENXIO);
 
-	if(!timeout)
-	{
-		device_printf(dev, "SATA AHCI Phy Calibration Failed!!\n");
-	}
-	for(tmp=0; tmp<0x3000; tmp++);
+	mtx_lock(&sc->sc_ch->mtx);
+	sc->sc_alpm = val;
+	if (val == A10_AHCI_ALPM_OFF)
+		a10_ahci_alpm_sctl(sc, 0);
+	/* Going more active than the current state: wake the link now. */
+	if ((sc->sc_link == A10_AHCI_LINK_SLUMBER &&
+	    val != A10_AHCI_ALPM_SLUMBER) ||
+	    (sc->sc_link == A10_AHCI_LINK_PARTIAL &&
+	    val == A10_AHCI_ALPM_OFF)) {
+		sc->sc_alpm_slumber_next = 0;
+		a10_ahci_alpm_wake(sc);
+		sc->sc_alpm_settle = 1;
+		callout_reset(&sc->sc_alpm_callout, 1, a10_ahci_alpm_timeout,
+		    sc);
+	} else
+		a10_ahci_alpm_update(sc);
+	mtx_unlock(&sc->sc_ch->mtx);
 
-	SW_AHCI_ACCESS_LOCK(SW_AHCI_BASE, 0x07);
+	return (0);
+}
 
-	printf("---------- 11 ------------\n");
+/*
+ * The statistics are 64 bits wide and updated under the channel lock, so
+ * take it to read them in one piece.  arg2 is the offset in the softc.
+ */
+static int
+a10_ahci_alpm_stat_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_ahci_softc *sc;
+	uint64_t val;
 
-	/* Allocate resources */
-	sc->sc_mem_res = bus_alloc_resource_any(dev, SYS_RES_MEMORY,
-	    &mem_id, RF_ACTIVE);
-	if (sc->sc_mem_res == NULL) {
-		device_printf(dev, "could not allocate memory.\n");
-		return (ENOMEM);
-	}
+	sc = arg1;
+	mtx_lock(&sc->sc_ch->mtx);
+	val = *(uint64_t *)((char *)sc + arg2);
+	mtx_unlock(&sc->sc_ch->mtx);
+
+	return (sysctl_handle_64(oidp, &val, 0, req));
+}
 
-	printf("---------- 12 ------------\n");
+/* The counters the link filter bumps, read at offset arg2. */
+static int
+a10_ahci_filter_stat_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_ahci_softc *sc;
+	uint64_t val;
 
-	sc->sc_mem_res_bustag = rman_get_bustag(sc->sc_mem_res);
-	sc->sc_mem_res_bushdl = rman_get_bushandle(sc->sc_mem_res);
-	KASSERT(sc->sc_mem_res_bustag && sc->sc_mem_res_bushdl,
-	    ("cannot get bus handle or tag."));
+	sc = arg1;
+	mtx_lock_spin(&sc->sc_stat_mtx);
+	val = *(uint64_t *)((char *)sc + arg2);
+	mtx_unlock_spin(&sc->sc_stat_mtx);
 
-	printf("---------- 13 ------------\n");
+	return (sysctl_handle_64(oidp, &val, 0, req));
+}
 
-	sc->sc_irq_res = bus_alloc_resource_any(dev, SYS_RES_IRQ, &irq_id,
-	    RF_ACTIVE);
-	if (sc->sc_irq_res == NULL) {
-		device_printf(dev, "could not allocate IRQ.\n");
-		error = ENOMEM;
-		goto err;
+static int
+a10_ahci_alpm_time_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_ahci_softc *sc;
+	struct bintime bt, now;
+	uint64_t ms;
+
+	sc = arg1;
+	mtx_lock(&sc->sc_ch->mtx);
+	bt = sc->sc_alpm_time[arg2];
+	if (sc->sc_link == arg2) {
+		binuptime(&now);
+		bintime_sub(&now, &sc->sc_link_since);
+		bintime_add(&bt, &now);
 	}
+	mtx_unlock(&sc->sc_ch->mtx);
+	ms = (uint64_t)bt.sec * 1000 +
+	    (((uint64_t)1000 * (uint32_t)(bt.frac >> 32)) >> 32);
 
-	printf("---------- 0 ------------\n");
+	return (sysctl_handle_64(oidp, &ms, 0, req));
+}
 
-	error = bus_setup_intr(dev, sc->sc_irq_res,
-	    INTR_TYPE_BIO | INTR_MPSAFE | INTR_ENTROPY,
-	    NULL, a10_ahci_intr, sc, &sc->sc_irq_cookiep);
-	if (error != 0) {
-		device_printf(dev, "could not setup interrupt.\n");
-		goto err;
+static void
+a10_ahci_alpm_init(struct a10_ahci_softc *sc)
+{
+	struct sysctl_ctx_list *ctx;
+	struct sysctl_oid_list *tree;
+	struct sysctl_oid *node;
+	device_t chdev;
+
+	chdev = device_find_child(sc->sc_dev, "ahcich", -1);
+	if (chdev == NULL || !device_is_attached(chdev))
+		return;
+	sc->sc_ch = device_get_softc(chdev);
+	mtx_init(&sc->sc_stat_mtx, "a10_ahci stats", NULL, MTX_SPIN);
+
+	sc->sc_alpm = a10_ahci_alpm_default;
+	sc->sc_alpm_idle_ms = A10_AHCI_ALPM_IDLE_MS;
+	sc->sc_alpm_slumber_ms = A10_AHCI_ALPM_SLUMBER_MS;
+	sc->sc_link = A10_AHCI_LINK_ACTIVE;
+	binuptime(&sc->sc_link_since);
+
+	ctx = device_get_sysctl_ctx(sc->sc_dev);
+	tree = SYSCTL_CHILDREN(device_get_sysctl_tree(sc->sc_dev));
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "alpm",
+	    CTLTYPE_INT | CTLFLAG_RW, sc, 0, a10_ahci_alpm_sysctl, "I",
+	    "Link power management: 0 off, 1 partial, 2 partial and slumber");
+	SYSCTL_ADD_INT(ctx, tree, OID_AUTO, "alpm_idle_ms", CTLFLAG_RW,
+	    &sc->sc_alpm_idle_ms, 0, "Idle time before entering partial");
+	SYSCTL_ADD_INT(ctx, tree, OID_AUTO, "alpm_slumber_ms", CTLFLAG_RW,
+	    &sc->sc_alpm_slumber_ms, 0, "Idle time before entering slumber");
+
+	node = SYSCTL_ADD_NODE(ctx, tree, OID_AUTO, "alpm_stats", CTLFLAG_RD,
+	    NULL, "Link power management statistics");
+	tree = SYSCTL_CHILDREN(node);
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "partial",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_ahci_softc, sc_alpm_partial),
+	    a10_ahci_alpm_stat_sysctl, "QU", "Transitions to partial");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "slumber",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_ahci_softc, sc_alpm_slumber),
+	    a10_ahci_alpm_stat_sysctl, "QU", "Transitions to slumber");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "wakes",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_ahci_softc, sc_alpm_wakes),
+	    a10_ahci_alpm_stat_sysctl, "QU", "Transitions back to active");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "wakes_timed",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_ahci_softc, sc_alpm_wake_timed),
+	    a10_ahci_alpm_stat_sysctl, "QU",
+	    "Wakes requested by the driver and timed");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "wake_us",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_ahci_softc, sc_alpm_wake_us),
+	    a10_ahci_alpm_stat_sysctl, "QU",
+	    "Total latency of the timed wakes, in microseconds");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "wake_us_max",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_ahci_softc, sc_alpm_wake_us_max),
+	    a10_ahci_alpm_stat_sysctl, "QU",
+	    "Longest timed wake, in microseconds");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "active_ms",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc, A10_AHCI_LINK_ACTIVE,
+	    a10_ahci_alpm_time_sysctl, "QU", "Time with the link active");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "partial_ms",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc, A10_AHCI_LINK_PARTIAL,
+	    a10_ahci_alpm_time_sysctl, "QU", "Time with the link in partial");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "slumber_ms",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc, A10_AHCI_LINK_SLUMBER,
+	    a10_ahci_alpm_time_sysctl, "QU", "Time with the link in slumber");
+
+	tree = SYSCTL_CHILDREN(device_get_sysctl_tree(sc->sc_dev));
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "link_up",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_ahci_softc, sc_link_up),
+	    a10_ahci_filter_stat_sysctl, "QU", "Drives connected");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "link_down",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_ahci_softc, sc_link_down),
+	    a10_ahci_filter_stat_sysctl, "QU", "Drives disconnected");
+
+	callout_init_mtx(&sc->sc_alpm_callout, &sc->sc_ch->mtx, 0);
+	sc->sc_online = (ATA_INL(sc->sc_ch->r_mem, AHCI_P_SSTS) &
+	    ATA_SS_DET_MASK) == ATA_SS_DET_PHY_ONLINE;
+	/*
+	 * The core asked for a shareable interrupt, so we can sit on it:
+	 * the filter runs before the core's handler, our thread handler
+	 * after it.
+	 */
+	if (bus_setup_intr(sc->sc_dev, sc->sc_ctlr.irqs[0].r_irq,
+	    INTR_TYPE_BIO | INTR_MPSAFE, a10_ahci_link_filter,
+	    a10_ahci_link_intr, sc, &sc->sc_intrhand) != 0) {
+		device_printf(sc->sc_dev,
+		    "could not set up link filter, ALPM disabled\n");
+		sc->sc_alpm = A10_AHCI_ALPM_OFF;
 	}
 
-	printf("---------- 1 ------------\n");
+	mtx_lock(&sc->sc_ch->mtx);
+	a10_ahci_alpm_update(sc);
+	mtx_unlock(&sc->sc_ch->mtx);
+}
 
-	/* Attach channels */
-	for (i = 0; i < SATA_CHAN_NUM; i++) {
-		child = device_add_child(dev, "ahcich", -1);
+/*
+ * TV and CC may only be changed with coalescing disabled.  The core only
+ * looks at ctlr->ccc to route the coalesced interrupt, so it is safe to
+ * reprogram the thresholds underneath it.
+ */
+static void
+a10_ahci_ccc_program(struct a10_ahci_softc *sc)
+{
+	struct ahci_controller *ctlr;
+	uint32_t cccc;
+
+	ctlr = &sc->sc_ctlr;
+	cccc = A10_AHCI_READ_4(sc, AHCI_CCCC);
+	A10_AHCI_WRITE_4(sc, AHCI_CCCC, cccc & ~AHCI_CCCC_EN);
+	cccc &= ~(AHCI_CCCC_TV_MASK | AHCI_CCCC_CC_MASK | AHCI_CCCC_EN);
+	cccc |= (ctlr->ccc << AHCI_CCCC_TV_SHIFT) |
+	    (sc->sc_ccc_count << AHCI_CCCC_CC_SHIFT);
+	A10_AHCI_WRITE_4(sc, AHCI_CCCC, cccc);
+	A10_AHCI_WRITE_4(sc, AHCI_CCCC, cccc | AHCI_CCCC_EN);
+}
 
-		if (!child) {
-			device_printf(dev, "cannot add channel %d.\n", i);
-			error = ENOMEM;
-			goto err;
-		}
+static int
+a10_ahci_ccc_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_ahci_softc *sc;
+	int error, val;
+
+	sc = arg1;
+	val = (arg2 == 0) ? sc->sc_ctlr.ccc : sc->sc_ccc_count;
+	error = sysctl_handle_int(oidp, &val, 0, req);
+	if (error != 0 || req->newptr == NULL)
+		return (error);
+	/* Coalescing itself can only be turned on or off at boot. */
+	if (val < 1 || val > ((arg2 == 0) ? 0xffff : 0xff))
+		return (EINVAL);
+
+	mtx_lock(&sc->sc_ch->mtx);
+	if (arg2 == 0)
+		sc->sc_ctlr.ccc = val;
+	else
+		sc->sc_ccc_count = val;
+	a10_ahci_ccc_program(sc);
+	mtx_unlock(&sc->sc_ch->mtx);
+
+	return (0);
+}
+
+static void
+a10_ahci_ccc_init(struct a10_ahci_softc *sc)
+{
+	struct sysctl_ctx_list *ctx;
+	struct sysctl_oid_list *tree;
+
+	/* The core turns it off if CAP.CCCS is clear. */
+	if (sc->sc_ctlr.ccc == 0 || sc->sc_ch == NULL)
+		return;
+
+	sc->sc_ccc_count = a10_ahci_ccc_count;
+	if (sc->sc_ccc_count < 1 || sc->sc_ccc_count > 0xff)
+		sc->sc_ccc_count = A10_AHCI_CCC_COUNT;
+	mtx_lock(&sc->sc_ch->mtx);
+	a10_ahci_ccc_program(sc);
+	mtx_unlock(&sc->sc_ch->mtx);
+
+	ctx = device_get_sysctl_ctx(sc->sc_dev);
+	tree = SYSCTL_CHILDREN(device_get_sysctl_tree(sc->sc_dev));
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "ccc_time",
+	    CTLTYPE_INT | CTLFLAG_RW, sc, 0, a10_ahci_ccc_sysctl, "I",
+	    "Completion coalescing timeout (ms)");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "ccc_count",
+	    CTLTYPE_INT | CTLFLAG_RW, sc, 1, a10_ahci_ccc_sysctl, "I",
+	    "Completion coalescing command count");
+}
+
+/*
+ * P0DMACR may only be changed while the port DMA engine is stopped.  The
+ * core keeps it running from ahci_attach() on, so unless it happens to be
+ * stopped the update is left to a10_ahci_dmacr_task(), queued once the
+ * port has nothing in flight; the interrupt that finds the port idle
+ * queues it again.  Called with the channel lock held.
+ */
+static void
+a10_ahci_dmacr_apply(struct a10_ahci_softc *sc)
+{
+	struct ahci_channel *ch;
+
+	ch = sc->sc_ch;
+	if ((ATA_INL(ch->r_mem, AHCI_P_CMD) &
+	    (AHCI_P_CMD_ST | AHCI_P_CMD_CR)) == 0) {
+		A10_AHCI_WRITE_4(sc, SW_AHCI_P0DMACR_OFFSET, sc->sc_dmacr);
+		sc->sc_dmacr_pending = 0;
+		return;
 	}
+	sc->sc_dmacr_pending = 1;
+	if (ch->numrslots == 0 && !sc->sc_suspended)
+		taskqueue_enqueue(taskqueue_thread, &sc->sc_dmacr_task);
+}
+
+/*
+ * Stopping the DMA engine can take up to 500ms, so it is done from a
+ * task that sleeps while it waits, without the channel lock.  The SIM
+ * queue stays frozen meanwhile so that the core issues nothing until
+ * the engine runs again.
+ */
+static void
+a10_ahci_dmacr_task(void *arg, int npending)
+{
+	struct a10_ahci_softc *sc;
+	struct ahci_channel *ch;
+	uint32_t cmd;
+	int deadline, stopped;
+
+	sc = arg;
+	ch = sc->sc_ch;
+	mtx_lock(&ch->mtx);
+	if (!sc->sc_dmacr_pending || sc->sc_suspended ||
+	    ch->numrslots != 0) {
+		mtx_unlock(&ch->mtx);
+		return;
+	}
+	xpt_freeze_simq(ch->sim, 1);
+	cmd = ATA_INL(ch->r_mem, AHCI_P_CMD);
+	ATA_OUTL(ch->r_mem, AHCI_P_CMD, cmd & ~AHCI_P_CMD_ST);
+	mtx_unlock(&ch->mtx);
+
+	deadline = ticks + max(1, A10_AHCI_STOP_TIMEOUT_MS * hz / 1000);
+	while (!(stopped = (ATA_INL(ch->r_mem, AHCI_P_CMD) &
+	    AHCI_P_CMD_CR) == 0) && ticks - deadline < 0)
+		pause("a10dma", 1);
+
+	mtx_lock(&ch->mtx);
+	if (stopped) {
+		A10_AHCI_WRITE_4(sc, SW_AHCI_P0DMACR_OFFSET, sc->sc_dmacr);
+		sc->sc_dmacr_pending = 0;
+	} else
+		device_printf(sc->sc_dev,
+		    "port DMA did not stop, P0DMACR left unchanged\n");
+	if (cmd & AHCI_P_CMD_ST)
+		ATA_OUTL(ch->r_mem, AHCI_P_CMD,
+		    ATA_INL(ch->r_mem, AHCI_P_CMD) | AHCI_P_CMD_ST);
+	xpt_release_simq(ch->sim, TRUE);
+	mtx_unlock(&ch->mtx);
+}
 
-	printf("---------- 2 ------------\n");
+static int
+a10_ahci_dmacr_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_ahci_softc *sc;
+	int error, val;
+
+	sc = arg1;
+	val = (sc->sc_dmacr >> arg2) & 0xf;
+	error = sysctl_handle_int(oidp, &val, 0, req);
+	if (error != 0 || req->newptr == NULL)
+		return (error);
+	if (val < 0 || val > 0xf)
+		return (EINVAL);
 
+	mtx_lock(&sc->sc_ch->mtx);
+	sc->sc_dmacr &= ~(0xf << arg2);
+	sc->sc_dmacr |= val << arg2;
+	a10_ahci_dmacr_apply(sc);
+	mtx_unlock(&sc->sc_ch->mtx);
 
-	bus_generic_attach(dev);
 	return (0);
+}
 
-err:
-	a10_ahci_detach(dev);
-	return (error);
+static void
+a10_ahci_dmacr_init(struct a10_ahci_softc *sc)
+{
+	struct sysctl_ctx_list *ctx;
+	struct sysctl_oid_list *tree;
+	phandle_t node;
+	pcell_t cell;
+
+	if (sc->sc_ch == NULL)
+		return;
+
+	sc->sc_dmacr = A10_AHCI_DMACR_DEFAULT;
+	node = ofw_bus_get_node(sc->sc_dev);
+	if ((OF_getprop(node, "allwinner,p0dmacr", &cell,
+	    sizeof(cell))) > 0)
+		sc->sc_dmacr = fdt32_to_cpu(cell) & SW_AHCI_P0DMACR_MASK;
+
+	TASK_INIT(&sc->sc_dmacr_task, 0, a10_ahci_dmacr_task, sc);
+	mtx_lock(&sc->sc_ch->mtx);
+	a10_ahci_dmacr_apply(sc);
+	mtx_unlock(&sc->sc_ch->mtx);
+
+	ctx = device_get_sysctl_ctx(sc->sc_dev);
+	tree = SYSCTL_CHILDREN(device_get_sysctl_tree(sc->sc_dev));
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "dma_tx_size",
+	    CTLTYPE_INT | CTLFLAG_RW, sc, SW_AHCI_P0DMACR_TXTS_SHIFT,
+	    a10_ahci_dmacr_sysctl, "I", "DMA transmit transaction size");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "dma_rx_size",
+	    CTLTYPE_INT | CTLFLAG_RW, sc, SW_AHCI_P0DMACR_RXTS_SHIFT,
+	    a10_ahci_dmacr_sysctl, "I", "DMA receive transaction size");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "dma_tx_burst",
+	    CTLTYPE_INT | CTLFLAG_RW, sc, SW_AHCI_P0DMACR_TXABL_SHIFT,
+	    a10_ahci_dmacr_sysctl, "I", "DMA transmit AHB burst limit");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "dma_rx_burst",
+	    CTLTYPE_INT | CTLFLAG_RW, sc, SW_AHCI_P0DMACR_RXABL_SHIFT,
+	    a10_ahci_dmacr_sysctl, "I", "DMA receive AHB burst limit");
 }
 
+static const struct {
+	uint32_t	bit;
+	const char	*name;
+	const char	*desc;
+} a10_ahci_serr_names[] = {
+	{ ATA_SE_DATA_CORRECTED, "data_recovered", "Recovered data errors" },
+	{ ATA_SE_COMM_CORRECTED, "comm_recovered", "Recovered comm errors" },
+	{ ATA_SE_DATA_ERR,	"data",		"Transient data errors" },
+	{ ATA_SE_COMM_ERR,	"comm",		"Persistent comm errors" },
+	{ ATA_SE_PROT_ERR,	"protocol",	"Protocol errors" },
+	{ ATA_SE_HOST_ERR,	"internal",	"Internal errors" },
+	{ ATA_SE_PHY_IERROR,	"phy_internal",	"PHY internal errors" },
+	{ ATA_SE_COMM_WAKE,	"comm_wake",	"COMWAKE detected" },
+	{ ATA_SE_DECODE_ERR,	"decode",	"10b to 8b decode errors" },
+	{ ATA_SE_PARITY_ERR,	"disparity",	"Disparity errors" },
+	{ ATA_SE_CRC_ERR,	"crc",		"CRC errors" },
+	{ ATA_SE_HANDSHAKE_ERR,	"handshake",	"Handshake errors" },
+	{ ATA_SE_LINKSEQ_ERR,	"link_sequence", "Link sequence errors" },
+	{ ATA_SE_TRANSPORT_ERR,	"transport",	"Transport state errors" },
+	{ ATA_SE_UNKNOWN_FIS,	"unknown_fis",	"Unrecognised FIS types" },
+};
+
 static int
-a10_ahci_detach(device_t dev)
+a10_ahci_reg_sysctl(SYSCTL_HANDLER_ARGS)
 {
 	struct a10_ahci_softc *sc;
+	u_int val;
 
-	sc = device_get_softc(dev);
+	sc = arg1;
+	/* Nothing answers on the bus with the SATA clocks gated. */
+	if (!sc->sc_clk_on)
+		return (ENXIO);
+	val = A10_AHCI_READ_4(sc, arg2);
 
-	if (device_is_attached(dev))
-		bus_generic_detach(dev);
+	return (sysctl_handle_int(oidp, &val, 0, req));
+}
 
-	if (sc->sc_mem_res != NULL) {
-		bus_release_resource(dev, SYS_RES_MEMORY,
-		    rman_get_rid(sc->sc_mem_res), sc->sc_mem_res);
-		sc->sc_mem_res = NULL;
-	}
+static int
+a10_ahci_phy_state_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_ahci_softc *sc;
+	int val;
+
+	sc = arg1;
+	if (!sc->sc_clk_on)
+		return (ENXIO);
+	val = A10_AHCI_PHY_STATE(A10_AHCI_READ_4(sc, SW_AHCI_PHYCS0R_OFFSET));
+
+	return (sysctl_handle_int(oidp, &val, 0, req));
+}
+
+static int
+a10_ahci_speed_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_ahci_softc *sc;
+	const char *speed;
+	uint32_t ssts;
+
+	sc = arg1;
+	if (!sc->sc_clk_on)
+		return (ENXIO);
+	ssts = ATA_INL(sc->sc_ch->r_mem, AHCI_P_SSTS);
+	if ((ssts & ATA_SS_DET_MASK) != ATA_SS_DET_PHY_ONLINE)
+		speed = "down";
+	else if ((ssts & ATA_SS_SPD_MASK) == ATA_SS_SPD_GEN1)
+		speed = "1.5Gb/s";
+	else if ((ssts & ATA_SS_SPD_MASK) == ATA_SS_SPD_GEN2)
+		speed = "3.0Gb/s";
+	else
+		speed = "unknown";
+
+	return (sysctl_handle_string(oidp, __DECONST(char *, speed), 0, req));
+}
+
+/*
+ * Near-end analog loopback BIST: the PHY receives its own transmit
+ * pattern for A10_AHCI_BIST_MS and counts what came back wrong.  This
+ * checks the SoC side of the link only, and needs the port to be empty;
+ * cable problems show up in the SError counters instead.
+ */
+static int
+a10_ahci_bist_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_ahci_softc *sc;
+	struct ahci_channel *ch;
+	uint32_t bistsr;
+	int error, val;
+
+	sc = arg1;
+	ch = sc->sc_ch;
+	val = 0;
+	error = sysctl_handle_int(oidp, &val, 0, req);
+	if (error != 0 || req->newptr == NULL || val == 0)
+		return (error);
+	if (!sc->sc_clk_on)
+		return (ENXIO);
 
-	if (sc->sc_irq_res != NULL) {
-		bus_teardown_intr(dev, sc->sc_irq_res, sc->sc_irq_cookiep);
-		bus_release_resource(dev, SYS_RES_IRQ,
-		    rman_get_rid(sc->sc_irq_res), sc->sc_irq_res);
-		sc->sc_irq_res = NULL;
+	mtx_lock(&ch->mtx);
+	if (sc->sc_online || ch->numrslots != 0 || sc->sc_bist_running) {
+		mtx_unlock(&ch->mtx);
+		return (EBUSY);
 	}
+	sc->sc_bist_running = 1;
+	SW_AHCI_ACCESS_LOCK(sc, 0);
+	A10_AHCI_WRITE_4(sc, SW_AHCI_BISTCR_OFFSET, SW_AHCI_BISTCR_CNTCLR);
+	A10_AHCI_WRITE_4(sc, SW_AHCI_BISTCR_OFFSET,
+	    SW_AHCI_BISTCR_NEALB | SW_AHCI_BISTCR_ERREN);
+	mtx_unlock(&ch->mtx);
+
+	pause("a10bist", max(1, A10_AHCI_BIST_MS * hz / 1000));
+
+	mtx_lock(&ch->mtx);
+	sc->sc_bist_fis = A10_AHCI_READ_4(sc, SW_AHCI_BISTFCTR_OFFSET);
+	bistsr = A10_AHCI_READ_4(sc, SW_AHCI_BISTSR_OFFSET);
+	sc->sc_bist_frame_errors = bistsr & SW_AHCI_BISTSR_FRAMERR;
+	sc->sc_bist_burst_errors = (bistsr & SW_AHCI_BISTSR_BRSTERR) >>
+	    SW_AHCI_BISTSR_BRSTERR_SHIFT;
+	sc->sc_bist_dword_errors = A10_AHCI_READ_4(sc,
+	    SW_AHCI_BISTDECR_OFFSET);
+	A10_AHCI_WRITE_4(sc, SW_AHCI_BISTCR_OFFSET, 0);
+	SW_AHCI_ACCESS_LOCK(sc, 0x07);
+	sc->sc_bist_running = 0;
+	a10_ahci_alpm_update(sc);
+	mtx_unlock(&ch->mtx);
 
 	return (0);
 }
 
 static void
-a10_ahci_intr(void *xsc)
+a10_ahci_diag_init(struct a10_ahci_softc *sc)
+{
+	struct sysctl_ctx_list *ctx;
+	struct sysctl_oid_list *tree, *serr;
+	struct sysctl_oid *node;
+	int i;
+
+	if (sc->sc_ch == NULL)
+		return;
+
+	ctx = device_get_sysctl_ctx(sc->sc_dev);
+	tree = SYSCTL_CHILDREN(device_get_sysctl_tree(sc->sc_dev));
+	node = SYSCTL_ADD_NODE(ctx, tree, OID_AUTO, "phy", CTLFLAG_RD,
+	    NULL, "PHY diagnostics");
+	tree = SYSCTL_CHILDREN(node);
+
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "state",
+	    CTLTYPE_INT | CTLFLAG_RD, sc, 0, a10_ahci_phy_state_sysctl, "I",
+	    "PHY power state (2 is powered up)");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "speed",
+	    CTLTYPE_STRING | CTLFLAG_RD, sc, 0, a10_ahci_speed_sysctl, "A",
+	    "Negotiated link speed");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "phycs0r",
+	    CTLTYPE_UINT | CTLFLAG_RD, sc, SW_AHCI_PHYCS0R_OFFSET,
+	    a10_ahci_reg_sysctl, "IU", "PHY control/status 0");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "phycs1r",
+	    CTLTYPE_UINT | CTLFLAG_RD, sc, SW_AHCI_PHYCS1R_OFFSET,
+	    a10_ahci_reg_sysctl, "IU", "PHY control/status 1");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "phycs2r",
+	    CTLTYPE_UINT | CTLFLAG_RD, sc, SW_AHCI_PHYCS2R_OFFSET,
+	    a10_ahci_reg_sysctl, "IU", "PHY control/status 2 (calibration)");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "p0phycr",
+	    CTLTYPE_UINT | CTLFLAG_RD, sc, SW_AHCI_P0PHYCR_OFFSET,
+	    a10_ahci_reg_sysctl, "IU", "Port 0 PHY control");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "p0physr",
+	    CTLTYPE_UINT | CTLFLAG_RD, sc, SW_AHCI_P0PHYSR_OFFSET,
+	    a10_ahci_reg_sysctl, "IU", "Port 0 PHY status");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "oobr",
+	    CTLTYPE_UINT | CTLFLAG_RD, sc, SW_AHCI_OOBR_OFFSET,
+	    a10_ahci_reg_sysctl, "IU", "OOB signalling timing");
+
+	node = SYSCTL_ADD_NODE(ctx, tree, OID_AUTO, "serr", CTLFLAG_RD,
+	    NULL, "SError events");
+	serr = SYSCTL_CHILDREN(node);
+	for (i = 0; i < nitems(a10_ahci_serr_names); i++)
+		SYSCTL_ADD_PROC(ctx, serr, OID_AUTO,
+		    a10_ahci_serr_names[i].name, CTLTYPE_U64 | CTLFLAG_RD, sc,
+		    __offsetof(struct a10_ahci_softc, sc_serr) +
+		    sizeof(uint64_t) * (ffs(a10_ahci_serr_names[i].bit) - 1),
+		    a10_ahci_filter_stat_sysctl, "QU",
+		    a10_ahci_serr_names[i].desc);
+
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "bist",
+	    CTLTYPE_INT | CTLFLAG_RW, sc, 0, a10_ahci_bist_sysctl, "I",
+	    "Write 1 to run a loopback self-test on an empty port");
+	SYSCTL_ADD_UINT(ctx, tree, OID_AUTO, "bist_fis", CTLFLAG_RD,
+	    &sc->sc_bist_fis, 0, "FISes seen by the last self-test");
+	SYSCTL_ADD_UINT(ctx, tree, OID_AUTO, "bist_frame_errors", CTLFLAG_RD,
+	    &sc->sc_bist_frame_errors, 0, "Frame errors in the last self-test");
+	SYSCTL_ADD_UINT(ctx, tree, OID_AUTO, "bist_burst_errors", CTLFLAG_RD,
+	    &sc->sc_bist_burst_errors, 0, "Burst errors in the last self-test");
+	SYSCTL_ADD_UINT(ctx, tree, OID_AUTO, "bist_dword_errors", CTLFLAG_RD,
+	    &sc->sc_bist_dword_errors, 0, "DWORD errors in the last self-test");
+}
+
+/*
+ * PHY power up, calibration and the link reset done by ahci_attach() can
+ * take a good fraction of a second with a slow disk, so do them from a
+ * config_intrhook rather than holding up the rest of autoconfiguration.
+ */
+static void
+a10_ahci_start(void *arg)
 {
 	struct a10_ahci_softc *sc;
-	int unit;
+	device_t dev;
+	char name[32], val[8];
+	uint32_t caps;
+	int ccc;
+
+	sc = arg;
+	dev = sc->sc_dev;
+
+	if (a10_ahci_clk_enable(sc) != 0)
+		goto out;
+	if (a10_ahci_phy_init(sc) != 0) {
+		a10_ahci_clk_disable(sc);
+		goto out;
+	}
+
+	/*
+	 * PI is read-only zero until written once after reset; the core
+	 * needs it to create the ahcich child for our single port.
+	 */
+	A10_AHCI_WRITE_4(sc, AHCI_PI, A10_AHCI_PI);
 
-	sc = xsc;
+	/*
+	 * The core sizes its command list from CAP.NCS and enables NCQ from
+	 * CAP.SNCQ; the A10 advertises 32 slots with NCQ, so tagged queuing
+	 * comes for free.  Complain if a board ever strapped that off.
+	 */
+	caps = A10_AHCI_READ_4(sc, AHCI_CAP);
+	if ((caps & AHCI_CAP_SNCQ) == 0 ||
+	    ((caps & AHCI_CAP_NCS) >> AHCI_CAP_NCS_SHIFT) + 1 != 32)
+		device_printf(dev, "NCQ not fully supported (CAP 0x%08x)\n",
+		    caps);
+	if (a10_ahci_pmp != 0 && bootverbose)
+		device_printf(dev, "port multiplier support enabled, %s\n",
+		    (caps & AHCI_CAP_FBSS) ? "FIS-based switching" :
+		    "command-based switching");
 
 	/*
-	 * Behave like ata_generic_intr() for PCI controllers.
-	 * Simply invoke ISRs on all channels.
+	 * The core only learns the coalescing timeout from its "ccc" hint,
+	 * and has to know about it before the channel is set up, since it
+	 * then stops asking for a per-command interrupt.
 	 */
-	for (unit = 0; unit < SATA_CHAN_NUM; unit++)
-		if (sc->sc_interrupt[unit].function != NULL)
-			sc->sc_interrupt[unit].function(
-				sc->sc_interrupt[unit].argument);
+	if (resource_int_value(device_get_name(dev), device_get_unit(dev),
+	    "ccc", &ccc) != 0 && a10_ahci_ccc_time > 0) {
+		snprintf(name, sizeof(name), "hint.%s.%d.ccc",
+		    device_get_name(dev), device_get_unit(dev));
+		snprintf(val, sizeof(val), "%d", min(a10_ahci_ccc_time,
+		    0xffff));
+		setenv(name, val);
+	}
+
+	if (ahci_attach(dev) != 0) {
+		device_printf(dev, "could not attach the AHCI core\n");
+		a10_ahci_clk_disable(sc);
+	} else {
+		sc->sc_attached = 1;
+		a10_ahci_alpm_init(sc);
+		a10_ahci_ccc_init(sc);
+		a10_ahci_dmacr_init(sc);
+		a10_ahci_diag_init(sc);
+	}
+
+out:
+	config_intrhook_disestablish(&sc->sc_hook);
+	sc->sc_hook_pending = 0;
 }
 
-static struct resource *
-a10_ahci_alloc_resource(device_t dev, device_t child, int type, int *rid,
-    u_long start, u_long end, u_long count, u_int flags)
+static int
+a10_ahci_attach(device_t dev)
 {
 	struct a10_ahci_softc *sc;
+	struct ahci_controller *ctlr;
 
 	sc = device_get_softc(dev);
+	sc->sc_dev = dev;
+	ctlr = &sc->sc_ctlr;
+	ctlr->dev = dev;
+	/* Keeps ahci_setup_interrupt() away from the pci(4) MSI calls. */
+	ctlr->quirks = AHCI_Q_NOMSI;
+	if (a10_ahci_pmp == 0)
+		ctlr->quirks |= AHCI_Q_NOPMP;
+
+	ctlr->r_rid = 0;
+	ctlr->r_mem = bus_alloc_resource_any(dev, SYS_RES_MEMORY,
+	    &ctlr->r_rid, RF_ACTIVE);
+	if (ctlr->r_mem == NULL) {
+		device_printf(dev, "could not allocate memory.\n");
+		return (ENXIO);
+	}
 
-	KASSERT(type == SYS_RES_IRQ && *rid == ATA_IRQ_RID,
-	    ("illegal resource request (type %u, rid %u).",
-	    type, *rid));
+	sc->sc_hook.ich_func = a10_ahci_start;
+	sc->sc_hook.ich_arg = sc;
+	if (config_intrhook_establish(&sc->sc_hook) != 0) {
+		bus_release_resource(dev, SYS_RES_MEMORY, ctlr->r_rid,
+		    ctlr->r_mem);
+		ctlr->r_mem = NULL;
+		return (ENOMEM);
+	}
+	sc->sc_hook_pending = 1;
 
-	return (sc->sc_irq_res);
+	return (0);
 }
 
 static int
-a10_ahci_release_resource(device_t dev, device_t child, int type, int rid,
-    struct resource *r)
+a10_ahci_detach(device_t dev)
 {
+	struct a10_ahci_softc *sc;
+	struct ahci_controller *ctlr;
+	int error;
+
+	sc = device_get_softc(dev);
+	ctlr = &sc->sc_ctlr;
+
+	if (sc->sc_hook_pending) {
+		config_intrhook_disestablish(&sc->sc_hook);
+		sc->sc_hook_pending = 0;
+	}
+
+	if (sc->sc_ch != NULL) {
+		/* The thread handler arms the callout, so it goes first. */
+		if (sc->sc_intrhand != NULL) {
+			bus_teardown_intr(dev, ctlr->irqs[0].r_irq,
+			    sc->sc_intrhand);
+			sc->sc_intrhand = NULL;
+		}
+		callout_drain(&sc->sc_alpm_callout);
+		taskqueue_drain(taskqueue_thread, &sc->sc_dmacr_task);
+		mtx_destroy(&sc->sc_stat_mtx);
+		sc->sc_ch = NULL;
+	}
 
-	KASSERT(type == SYS_RES_IRQ && rid == ATA_IRQ_RID,
-	    ("strange type %u and/or rid %u while releasing resource.", type,
-	    rid));
+	/* ahci_detach() also releases the memory resource. */
+	if (sc->sc_attached) {
+		error = ahci_detach(dev);
+		if (error != 0)
+			return (error);
+		sc->sc_attached = 0;
+	} else if (ctlr->r_mem != NULL) {
+		bus_release_resource(dev, SYS_RES_MEMORY, ctlr->r_rid,
+		    ctlr->r_mem);
+		ctlr->r_mem = NULL;
+	}
+	a10_ahci_clk_disable(sc);
 
 	return (0);
 }
 
 static int
-a10_ahci_setup_intr(device_t dev, device_t child, struct resource *irq, int flags,
-    driver_filter_t *filt, driver_intr_t *function, void *argument,
-    void **cookiep)
+a10_ahci_suspend(device_t dev)
 {
 	struct a10_ahci_softc *sc;
-	struct ata_channel *ch;
+	int error;
 
 	sc = device_get_softc(dev);
-	ch = device_get_softc(child);
-
-	if (filt != NULL) {
-		device_printf(dev, "filter interrupts are not supported.\n");
-		return (EINVAL);
+	if (sc->sc_ch != NULL) {
+		mtx_lock(&sc->sc_ch->mtx);
+		sc->sc_suspended = 1;
+		callout_stop(&sc->sc_alpm_callout);
+		mtx_unlock(&sc->sc_ch->mtx);
+		callout_drain(&sc->sc_alpm_callout);
+		/* A pending P0DMACR update is redone on resume. */
+		taskqueue_drain(taskqueue_thread, &sc->sc_dmacr_task);
 	}
-
-	sc->sc_interrupt[ch->unit].function = function;
-	sc->sc_interrupt[ch->unit].argument = argument;
-	*cookiep = sc;
+	error = bus_generic_suspend(dev);
+	if (error != 0) {
+		if (sc->sc_ch != NULL) {
+			mtx_lock(&sc->sc_ch->mtx);
+			sc->sc_suspended = 0;
+			a10_ahci_alpm_update(sc);
+			mtx_unlock(&sc->sc_ch->mtx);
+		}
+		return (error);
+	}
+	a10_ahci_clk_disable(sc);
 
 	return (0);
 }
 
 static int
-a10_ahci_teardown_intr(device_t dev, device_t child, struct resource *irq,
-    void *cookie)
+a10_ahci_resume(device_t dev)
 {
 	struct a10_ahci_softc *sc;
-	struct ata_channel *ch;
+	int error;
 
 	sc = device_get_softc(dev);
-	ch = device_get_softc(child);
-
-	sc->sc_interrupt[ch->unit].function = NULL;
-	sc->sc_interrupt[ch->unit].argument = NULL;
+	if (!sc->sc_attached)
+		return (0);
+
+	error = a10_ahci_clk_enable(sc);
+	if (error != 0)
+		return (error);
+	error = a10_ahci_phy_init(sc);
+	if (error != 0)
+		return (error);
+	A10_AHCI_WRITE_4(sc, AHCI_PI, A10_AHCI_PI);
+	error = ahci_ctlr_reset(dev);
+	if (error != 0)
+		return (error);
+	ahci_ctlr_setup(dev);
+	error = bus_generic_resume(dev);
+	if (error != 0)
+		return (error);
+
+	if (sc->sc_ch != NULL) {
+		mtx_lock(&sc->sc_ch->mtx);
+		sc->sc_suspended = 0;
+		sc->sc_pm_window = 0;
+		sc->sc_alpm_wake_timing = 0;
+		sc->sc_alpm_slumber_next = 0;
+		/* ahci_ctlr_setup() put back the core's own count. */
+		if (sc->sc_ccc_count != 0)
+			a10_ahci_ccc_program(sc);
+		/* The HBA reset may also have cleared P0DMACR. */
+		a10_ahci_dmacr_apply(sc);
+		a10_ahci_alpm_update(sc);
+		mtx_unlock(&sc->sc_ch->mtx);
+	}
 
 	return (0);
 }
 
 static device_method_t a10_ahci_methods[] = {
-	/* Device method */
+	/* Device interface */
 	DEVMETHOD(device_probe,		a10_ahci_probe),
 	DEVMETHOD(device_attach,	a10_ahci_attach),
 	DEVMETHOD(device_detach,	a10_ahci_detach),
 	DEVMETHOD(device_shutdown,	bus_generic_shutdown),
-	DEVMETHOD(device_suspend,	bus_generic_suspend),
-	DEVMETHOD(device_resume,	bus_generic_resume),
-
-	DEVMETHOD(bus_alloc_resource,		a10_ahci_alloc_resource),
-	DEVMETHOD(bus_release_resource,		a10_ahci_release_resource),
-	DEVMETHOD(bus_activate_resource,	bus_generic_activate_resource),
-	DEVMETHOD(bus_deactivate_resource,	bus_generic_deactivate_resource),
-	DEVMETHOD(bus_setup_intr,		a10_ahci_setup_intr),
-	DEVMETHOD(bus_teardown_intr,		a10_ahci_teardown_intr),
+	DEVMETHOD(device_suspend,	a10_ahci_suspend),
+	DEVMETHOD(device_resume,	a10_ahci_resume),
+
+	/* Bus interface, provided by the ahci core for its ahcich children */
+	DEVMETHOD(bus_print_child,		ahci_print_child),
+	DEVMETHOD(bus_alloc_resource,		ahci_alloc_resource),
+	DEVMETHOD(bus_release_resource,		ahci_release_resource),
+	DEVMETHOD(bus_setup_intr,		ahci_setup_intr),
+	DEVMETHOD(bus_teardown_intr,		ahci_teardown_intr),
+	DEVMETHOD(bus_child_location_str,	ahci_child_location_str),
+	DEVMETHOD(bus_get_dma_tag,		ahci_get_dma_tag),
 
 	DEVMETHOD_END
 };
 
 static driver_t a10_ahci_driver = {
-	"a10_ahci",
+	"ahci",
 	a10_ahci_methods,
 	sizeof(struct a10_ahci_softc),
 };
 
-devclass_t a10_ahci_devclass;
-
-DRIVER_MODULE(ahci, simplebus, a10_ahci_driver, a10_ahci_devclass, 0, 0);
-MODULE_VERSION(ahci, 1);
-MODULE_DEPEND(ahci, cam, 1, 1, 1);
-
+DRIVER_MODULE(a10_ahci, simplebus, a10_ahci_driver, ahci_devclass, 0, 0);
+MODULE_DEPEND(a10_ahci, ahci, 1, 1, 1);
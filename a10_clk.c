@@ -33,8 +33,10 @@ __FBSDID("$FreeBSD: head/sys/arm/allwinner/a10_clk.c 246851 2013-02-15 21:29:03Z
 #include <sys/systm.h>
 #include <sys/bus.h>
 #include <sys/kernel.h>
+#include <sys/lock.h>
 #include <sys/module.h>
 #include <sys/malloc.h>
+#include <sys/mutex.h>
 #include <sys/rman.h>
 #include <sys/timeet.h>
 #include <sys/timetc.h>
@@ -58,6 +60,7 @@ struct a10_ccm_softc {
 	struct resource		*res;
 	bus_space_tag_t		bst;
 	bus_space_handle_t	bsh;
+	struct mtx		mtx;	/* gating registers are shared */
 };
 
 static struct a10_ccm_softc *a10_ccm_sc = NULL;
@@ -66,6 +69,8 @@ static struct a10_ccm_softc *a10_ccm_sc = NULL;
 	bus_space_read_4((sc)->bst, (sc)->bsh, (reg))
 #define ccm_write_4(sc, reg, val)	\
 	bus_space_write_4((sc)->bst, (sc)->bsh, (reg), (val))
+#define ccm_lock(sc)			mtx_lock(&(sc)->mtx)
+#define ccm_unlock(sc)			mtx_unlock(&(sc)->mtx)
 
 static int
 a10_ccm_probe(device_t dev)
@@ -95,6 +100,7 @@ a10_ccm_attach(device_t dev)
 
 	sc->bst = rman_get_bustag(sc->res);
 	sc->bsh = rman_get_bushandle(sc->res);
+	mtx_init(&sc->mtx, "a10_ccm", NULL, MTX_DEF);
 
 	a10_ccm_sc = sc;
 
@@ -118,27 +124,128 @@ static devclass_t a10_ccm_devclass;
 DRIVER_MODULE(a10_ccm, simplebus, a10_ccm_driver, a10_ccm_devclass, 0, 0);
 
 int
-a10_clk_mmc_activate(void)
+a10_clk_mmc_activate(int devid)
 {
 	struct a10_ccm_softc *sc = a10_ccm_sc;
 	uint32_t reg_value;
 
 	if (sc == NULL)
 		return ENXIO;
+	if (devid < 0 || devid > 3)
+		return EINVAL;
 
+	ccm_lock(sc);
 	/* Gating AHB clock for MMC */
 	reg_value = ccm_read_4(sc, CCM_AHB_GATING0);
-	reg_value |= CCM_AHB_GATING_MMC0; /* AHB clock gate mmc0 */
+	reg_value |= CCM_AHB_GATING_MMC(devid); /* AHB clock gate mmcN */
 	ccm_write_4(sc, CCM_AHB_GATING0, reg_value);
 
 	/* Enable clock for MMC */
-	reg_value = ccm_read_4(sc, CCM_MMC0_SCLK_CFG);
+	reg_value = ccm_read_4(sc, CCM_MMC_SCLK_CFG(devid));
 	reg_value |= CCM_MMC0_SCLK_ON; /* Clock on */
-	ccm_write_4(sc, CCM_MMC0_SCLK_CFG, reg_value);
+	ccm_write_4(sc, CCM_MMC_SCLK_CFG(devid), reg_value);
+	ccm_unlock(sc);
 
 	return (0);
 }
 
+int
+a10_clk_mmc_deactivate(int devid)
+{
+	struct a10_ccm_softc *sc = a10_ccm_sc;
+	uint32_t reg_value;
+
+	if (sc == NULL)
+		return ENXIO;
+	if (devid < 0 || devid > 3)
+		return EINVAL;
+
+	ccm_lock(sc);
+	/* Disable clock for MMC, the dividers are kept */
+	reg_value = ccm_read_4(sc, CCM_MMC_SCLK_CFG(devid));
+	reg_value &= ~CCM_MMC0_SCLK_ON; /* Clock off */
+	ccm_write_4(sc, CCM_MMC_SCLK_CFG(devid), reg_value);
+
+	/* Disable gating AHB clock for MMC */
+	reg_value = ccm_read_4(sc, CCM_AHB_GATING0);
+	reg_value &= ~CCM_AHB_GATING_MMC(devid); /* disable AHB gate mmcN */
+	ccm_write_4(sc, CCM_AHB_GATING0, reg_value);
+	ccm_unlock(sc);
+
+	return (0);
+}
+
+int
+a10_clk_pll6_get_rate(void)
+{
+	struct a10_ccm_softc *sc = a10_ccm_sc;
+	uint32_t k, n, reg_value;
+
+	if (sc == NULL)
+		return (-1);
+
+	reg_value = ccm_read_4(sc, CCM_PLL6_CFG);
+	if ((reg_value & CCM_PLL_CFG_ENABLE) == 0)
+		return (-1);
+	n = (reg_value & CCM_PLL6_CFG_FACTOR_N) >> CCM_PLL6_CFG_FACTOR_N_SHIFT;
+	k = ((reg_value & CCM_PLL6_CFG_FACTOR_K) >>
+	    CCM_PLL6_CFG_FACTOR_K_SHIFT) + 1;
+
+	/* PLL6 = 24MHz * N * K / 2 */
+	return ((CCM_CLK_REF_FREQ * n * k) / 2);
+}
+
+/*
+ * Program the module clock of MMC controller devid as close to freq as
+ * possible without exceeding it.  Returns the resulting rate, or a
+ * negative value if the clock could not be set.
+ */
+int
+a10_clk_mmc_cfg(int devid, int freq)
+{
+	struct a10_ccm_softc *sc = a10_ccm_sc;
+	uint32_t clksrc, m, n, reg_value;
+	int pll_rate, rate;
+
+	if (sc == NULL || devid < 0 || devid > 3 || freq <= 0)
+		return (-1);
+
+	/* Identification frequencies come straight from the oscillator. */
+	if (freq <= 400000) {
+		pll_rate = CCM_CLK_REF_FREQ;
+		clksrc = CCM_SD_CLK_SRC_SEL_OSC24M;
+	} else {
+		pll_rate = a10_clk_pll6_get_rate();
+		if (pll_rate <= 0)
+			return (-1);
+		clksrc = CCM_SD_CLK_SRC_SEL_PLL6;
+	}
+
+	/* rate = pll_rate / (2^n * (m + 1)) */
+	for (n = 0; n < 4; n++) {
+		m = howmany(pll_rate >> n, freq);
+		if (m <= CCM_SD_CLK_DIV_RATIO_M + 1)
+			break;
+	}
+	if (n == 4)
+		return (-1);
+	if (m == 0)
+		m = 1;
+	rate = (pll_rate >> n) / m;
+
+	ccm_lock(sc);
+	reg_value = ccm_read_4(sc, CCM_MMC_SCLK_CFG(devid));
+	reg_value &= ~(CCM_SD_CLK_SRC_SEL | CCM_SD_CLK_DIV_RATIO_N |
+	    CCM_SD_CLK_DIV_RATIO_M);
+	reg_value |= (clksrc << CCM_SD_CLK_SRC_SEL_SHIFT);
+	reg_value |= (n << CCM_SD_CLK_DIV_RATIO_N_SHIFT);
+	reg_value |= (m - 1);
+	ccm_write_4(sc, CCM_MMC_SCLK_CFG(devid), reg_value);
+	ccm_unlock(sc);
+
+	return (rate);
+}
+
 int
 a10_clk_usb_activate(void)
 {
@@ -148,6 +255,7 @@ a10_clk_usb_activate(void)
 	if (sc == NULL)
 		return ENXIO;
 
+	ccm_lock(sc);
 	/* Gating AHB clock for USB */
 	reg_value = ccm_read_4(sc, CCM_AHB_GATING0);
 	reg_value |= CCM_AHB_GATING_USB0; /* AHB clock gate usb0 */
@@ -162,6 +270,7 @@ a10_clk_usb_activate(void)
 	reg_value |= CCM_USB1_RESET; /* disable reset for USB1 */
 	reg_value |= CCM_USB2_RESET; /* disable reset for USB2 */
 	ccm_write_4(sc, CCM_USB_CLK, reg_value);
+	ccm_unlock(sc);
 
 	return (0);
 }
@@ -175,6 +284,7 @@ a10_clk_usb_deactivate(void)
 	if (sc == NULL)
 		return ENXIO;
 
+	ccm_lock(sc);
 	/* Disable clock for USB */
 	reg_value = ccm_read_4(sc, CCM_USB_CLK);
 	reg_value &= ~CCM_USB_PHY; /* USBPHY */
@@ -188,7 +298,65 @@ a10_clk_usb_deactivate(void)
 	reg_value &= ~CCM_AHB_GATING_USB0; /* disable AHB clock gate usb0 */
 	reg_value &= ~CCM_AHB_GATING_EHCI1; /* disable AHB clock gate ehci1 */
 	ccm_write_4(sc, CCM_AHB_GATING0, reg_value);
+	ccm_unlock(sc);
 
 	return (0);
 }
 
+
+int
+a10_clk_sata_activate(void)
+{
+	struct a10_ccm_softc *sc = a10_ccm_sc;
+	uint32_t reg_value;
+
+	if (sc == NULL)
+		return ENXIO;
+
+	ccm_lock(sc);
+	/* Enable the SATA output of PLL6, the PLL itself is shared */
+	reg_value = ccm_read_4(sc, CCM_PLL6_CFG);
+	reg_value |= CCM_PLL6_CFG_SATA_CLK_EN;
+	ccm_write_4(sc, CCM_PLL6_CFG, reg_value);
+
+	/* Clock the SATA core from PLL6 */
+	reg_value = ccm_read_4(sc, CCM_SATA_CLK);
+	reg_value &= ~CCM_SATA_CLK_SRC_EXT;
+	reg_value |= CCM_SATA_CLK_GATING;
+	ccm_write_4(sc, CCM_SATA_CLK, reg_value);
+
+	/* Gating AHB clock for SATA */
+	reg_value = ccm_read_4(sc, CCM_AHB_GATING0);
+	reg_value |= CCM_AHB_GATING_SATA;
+	ccm_write_4(sc, CCM_AHB_GATING0, reg_value);
+	ccm_unlock(sc);
+
+	return (0);
+}
+
+int
+a10_clk_sata_deactivate(void)
+{
+	struct a10_ccm_softc *sc = a10_ccm_sc;
+	uint32_t reg_value;
+
+	if (sc == NULL)
+		return ENXIO;
+
+	ccm_lock(sc);
+	/* Disable gating AHB clock for SATA */
+	reg_value = ccm_read_4(sc, CCM_AHB_GATING0);
+	reg_value &= ~CCM_AHB_GATING_SATA;
+	ccm_write_4(sc, CCM_AHB_GATING0, reg_value);
+
+	reg_value = ccm_read_4(sc, CCM_SATA_CLK);
+	reg_value &= ~CCM_SATA_CLK_GATING;
+	ccm_write_4(sc, CCM_SATA_CLK, reg_value);
+
+	reg_value = ccm_read_4(sc, CCM_PLL6_CFG);
+	reg_value &= ~CCM_PLL6_CFG_SATA_CLK_EN;
+	ccm_write_4(sc, CCM_PLL6_CFG, reg_value);
+	ccm_unlock(sc);
+
+	return (0);
+}
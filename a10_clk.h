@@ -62,6 +62,7 @@
 #define CCM_MMC1_SCLK_CFG	0x008c
 #define CCM_MMC2_SCLK_CFG	0x0090
 #define CCM_MMC3_SCLK_CFG	0x0094
+#define CCM_MMC_SCLK_CFG(n)	(CCM_MMC0_SCLK_CFG + (n) * 4)
 #define CCM_TS_CLK		0x0098
 #define CCM_SS_CLK		0x009c
 #define CCM_SPI0_CLK		0x00a0
@@ -104,6 +105,8 @@
 #define CCM_AHB_GATING_EHCI0	(1 << 1)
 #define CCM_AHB_GATING_EHCI1	(1 << 3)
 #define CCM_AHB_GATING_MMC0	(1 << 8)
+#define CCM_AHB_GATING_MMC(n)	(CCM_AHB_GATING_MMC0 << (n))
+#define CCM_AHB_GATING_SATA	(1 << 25)
 
 #define CCM_USB_PHY		(1 << 8)
 #define CCM_USB0_RESET		(1 << 0)
@@ -112,7 +115,32 @@
 
 #define CCM_MMC0_SCLK_ON	(1 << 31)
 
-int a10_clk_mmc_activate(void);
+#define CCM_PLL_CFG_ENABLE	(1U << 31)
+#define CCM_PLL6_CFG_FACTOR_N	0x1f00
+#define CCM_PLL6_CFG_FACTOR_N_SHIFT	8
+#define CCM_PLL6_CFG_FACTOR_K	0x30
+#define CCM_PLL6_CFG_FACTOR_K_SHIFT	4
+#define CCM_PLL6_CFG_SATA_CLK_EN	(1 << 14)
+
+#define CCM_SATA_CLK_GATING	(1U << 31)
+#define CCM_SATA_CLK_SRC_EXT	(1 << 0)
+
+#define CCM_SD_CLK_SRC_SEL	0x3000000
+#define CCM_SD_CLK_SRC_SEL_SHIFT	24
+#define CCM_SD_CLK_SRC_SEL_OSC24M	0
+#define CCM_SD_CLK_SRC_SEL_PLL6	1
+#define CCM_SD_CLK_DIV_RATIO_N	0x30000
+#define CCM_SD_CLK_DIV_RATIO_N_SHIFT	16
+#define CCM_SD_CLK_DIV_RATIO_M	0xf
+
+#define CCM_CLK_REF_FREQ	24000000U
+
+int a10_clk_mmc_activate(int);
+int a10_clk_mmc_deactivate(int);
+int a10_clk_mmc_cfg(int, int);
+int a10_clk_pll6_get_rate(void);
+int a10_clk_sata_activate(void);
+int a10_clk_sata_deactivate(void);
 int a10_clk_usb_activate(void);
 int a10_clk_usb_deactivate(void);
 
@@ -52,6 +52,8 @@ __FBSDID("$FreeBSD: head/sys/arm/allwinner/a10_gpio.c 246955 2013-02-19 02:01:35
 #include <dev/ofw/ofw_bus.h>
 #include <dev/ofw/ofw_bus_subr.h>
 
+#include <arm/allwinner/a10_gpio.h>
+
 #include "gpio_if.h"
 
 /*
@@ -66,12 +68,16 @@ __FBSDID("$FreeBSD: head/sys/arm/allwinner/a10_gpio.c 246955 2013-02-19 02:01:35
 #define	A10_GPIO_DEFAULT_CAPS	(GPIO_PIN_INPUT | GPIO_PIN_OUTPUT |	\
     GPIO_PIN_PULLUP | GPIO_PIN_PULLDOWN)
 
-#define A10_GPIO_NONE		0
-#define A10_GPIO_PULLUP		1
-#define A10_GPIO_PULLDOWN	2
-
 #define A10_GPIO_INPUT		0
 #define A10_GPIO_OUTPUT		1
+#define A10_GPIO_EINT		6
+
+#define A10_GPIO_EINT_NUM	32
+
+struct a10_gpio_eint {
+	void			(*eh_handler)(void *);
+	void *			eh_arg;
+};
 
 struct a10_gpio_softc {
 	device_t		sc_dev;
@@ -83,8 +89,11 @@ struct a10_gpio_softc {
 	void *			sc_intrhand;
 	int			sc_gpio_npins;
 	struct gpio_pin		sc_gpio_pins[A10_GPIO_PINS];
+	struct a10_gpio_eint	sc_eint[A10_GPIO_EINT_NUM];
 };
 
+static struct a10_gpio_softc *a10_gpio_sc = NULL;
+
 #define	A10_GPIO_LOCK(_sc)		mtx_lock(&_sc->sc_mtx)
 #define	A10_GPIO_UNLOCK(_sc)		mtx_unlock(&_sc->sc_mtx)
 #define	A10_GPIO_LOCK_ASSERT(_sc)	mtx_assert(&_sc->sc_mtx, MA_OWNED)
@@ -98,6 +107,7 @@ struct a10_gpio_softc {
 #define	A10_GPIO_GP_INT_CFG1		0x204
 #define	A10_GPIO_GP_INT_CFG2		0x208
 #define	A10_GPIO_GP_INT_CFG3		0x20c
+#define	A10_GPIO_GP_INT_CFG(_n)		(A10_GPIO_GP_INT_CFG0 + ((_n) >> 3) * 4)
 
 #define	A10_GPIO_GP_INT_CTL		0x210
 #define	A10_GPIO_GP_INT_STA		0x214
@@ -350,12 +360,24 @@ a10_gpio_pin_set(device_t dev, uint32_t pin, unsigned int value)
 	return (0);
 }
 
+/* EINT0-EINT21 are on PH0-PH21, EINT22-EINT31 on PI10-PI19. */
+static int
+a10_gpio_pin_to_eint(uint32_t pin)
+{
+
+	if (pin >= A10_GPIO_PIN(7, 0) && pin <= A10_GPIO_PIN(7, 21))
+		return (pin - A10_GPIO_PIN(7, 0));
+	if (pin >= A10_GPIO_PIN(8, 10) && pin <= A10_GPIO_PIN(8, 19))
+		return (pin - A10_GPIO_PIN(8, 10) + 22);
+	return (-1);
+}
+
 static int
 a10_gpio_pin_get(device_t dev, uint32_t pin, unsigned int *val)
 {
 	struct a10_gpio_softc *sc = device_get_softc(dev);
-	uint32_t bank, offset, reg_data;
-	int i;
+	uint32_t bank, func, offset, reg_data;
+	int eint, i;
 
 	for (i = 0; i < sc->sc_gpio_npins; i++) {
 		if (sc->sc_gpio_pins[i].gp_pin == pin)
@@ -370,7 +392,23 @@ a10_gpio_pin_get(device_t dev, uint32_t pin, unsigned int *val)
 	offset = pin & 0x1f;
 
 	A10_GPIO_LOCK(sc);
+	/*
+	 * The data register is undefined while a pin is muxed to its
+	 * external interrupt function, so switch it to input just long
+	 * enough to sample it.  Function 6 is some other peripheral on
+	 * pins without an EINT line and is left alone.
+	 */
+	func = (A10_GPIO_READ(sc, A10_GPIO_GP_CFG(bank, pin >> 3)) >>
+	    ((pin & 0x07) << 2)) & 7;
+	eint = (func == A10_GPIO_EINT &&
+	    a10_gpio_pin_to_eint(sc->sc_gpio_pins[i].gp_pin) >= 0);
+	if (eint)
+		a10_gpio_set_function(sc, sc->sc_gpio_pins[i].gp_pin,
+		    A10_GPIO_INPUT);
 	reg_data = A10_GPIO_READ(sc, A10_GPIO_GP_DAT(bank));
+	if (eint)
+		a10_gpio_set_function(sc, sc->sc_gpio_pins[i].gp_pin,
+		    A10_GPIO_EINT);
 	A10_GPIO_UNLOCK(sc);
 	*val = (reg_data & (1 << offset)) ? 1 : 0;
 
@@ -408,6 +446,94 @@ a10_gpio_pin_toggle(device_t dev, uint32_t pin)
 	return (0);
 }
 
+/*
+ * Route a pin to one of its peripheral functions, for drivers that
+ * need their pads muxed before u-boot has done it for them.
+ */
+int
+a10_gpio_set_pin_func(uint32_t pin, uint32_t func, uint32_t pull)
+{
+	struct a10_gpio_softc *sc = a10_gpio_sc;
+
+	if (sc == NULL)
+		return (ENXIO);
+	if (pin >= A10_GPIO_PINS)
+		return (EINVAL);
+
+	A10_GPIO_LOCK(sc);
+	a10_gpio_set_function(sc, pin, func);
+	a10_gpio_set_pud(sc, pin, pull);
+	/* No longer a GPIO as far as gpio(4) is concerned. */
+	sc->sc_gpio_pins[pin].gp_flags = 0;
+	A10_GPIO_UNLOCK(sc);
+
+	return (0);
+}
+
+/*
+ * Switch a pin to its external interrupt function and call handler
+ * from the GPIO interrupt thread whenever it triggers.  The data
+ * register does not follow the pin in that function; gpio_pin_get
+ * muxes it back to input for the read.
+ */
+int
+a10_gpio_eint_setup(uint32_t pin, uint32_t mode, void (*handler)(void *),
+    void *arg)
+{
+	struct a10_gpio_softc *sc = a10_gpio_sc;
+	uint32_t offset, val;
+	int eint;
+
+	if (sc == NULL)
+		return (ENXIO);
+	eint = a10_gpio_pin_to_eint(pin);
+	if (eint < 0)
+		return (EINVAL);
+
+	A10_GPIO_LOCK(sc);
+	if (sc->sc_eint[eint].eh_handler != NULL) {
+		A10_GPIO_UNLOCK(sc);
+		return (EBUSY);
+	}
+	sc->sc_eint[eint].eh_handler = handler;
+	sc->sc_eint[eint].eh_arg = arg;
+
+	a10_gpio_set_function(sc, pin, A10_GPIO_EINT);
+	/* No longer a GPIO as far as gpio(4) is concerned. */
+	sc->sc_gpio_pins[pin].gp_flags = 0;
+
+	offset = (eint & 0x07) << 2;
+	val = A10_GPIO_READ(sc, A10_GPIO_GP_INT_CFG(eint));
+	val &= ~(0x0f << offset);
+	val |= (mode << offset);
+	A10_GPIO_WRITE(sc, A10_GPIO_GP_INT_CFG(eint), val);
+
+	A10_GPIO_WRITE(sc, A10_GPIO_GP_INT_STA, (1U << eint));
+	val = A10_GPIO_READ(sc, A10_GPIO_GP_INT_CTL);
+	A10_GPIO_WRITE(sc, A10_GPIO_GP_INT_CTL, val | (1U << eint));
+	A10_GPIO_UNLOCK(sc);
+
+	return (0);
+}
+
+static void
+a10_gpio_intr(void *arg)
+{
+	struct a10_gpio_softc *sc = arg;
+	uint32_t sta;
+	int i;
+
+	A10_GPIO_LOCK(sc);
+	sta = A10_GPIO_READ(sc, A10_GPIO_GP_INT_STA);
+	A10_GPIO_WRITE(sc, A10_GPIO_GP_INT_STA, sta);
+	A10_GPIO_UNLOCK(sc);
+
+	for (i = 0; i < A10_GPIO_EINT_NUM; i++) {
+		if ((sta & (1U << i)) != 0 && sc->sc_eint[i].eh_handler != NULL)
+			sc->sc_eint[i].eh_handler(sc->sc_eint[i].eh_arg);
+	}
+}
+
 static int
 a10_gpio_probe(device_t dev)
 {
@@ -468,6 +594,17 @@ a10_gpio_attach(device_t dev)
 	}
 	sc->sc_gpio_npins = i;
 
+	/* Mask and acknowledge external interrupts until someone asks. */
+	A10_GPIO_WRITE(sc, A10_GPIO_GP_INT_CTL, 0);
+	A10_GPIO_WRITE(sc, A10_GPIO_GP_INT_STA, 0xffffffff);
+	if (bus_setup_intr(dev, sc->sc_irq_res, INTR_TYPE_MISC | INTR_MPSAFE,
+	    NULL, a10_gpio_intr, sc, &sc->sc_intrhand)) {
+		device_printf(dev, "cannot setup interrupt handler\n");
+		goto fail;
+	}
+
+	a10_gpio_sc = sc;
+
 	device_add_child(dev, "gpioc", device_get_unit(dev));
 	device_add_child(dev, "gpiobus", device_get_unit(dev));
 	return (bus_generic_attach(dev));
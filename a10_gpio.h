@@ -0,0 +1,49 @@
+/*-
+ * Copyright (c) 2026 agent <agent@local>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _A10_GPIO_H_
+#define _A10_GPIO_H_
+
+/* Pin number as used by the gpio(4) interface, bank 0 is PA. */
+#define A10_GPIO_PIN(_bank, _pin)	((_bank) * 32 + (_pin))
+
+#define A10_GPIO_NONE		0
+#define A10_GPIO_PULLUP		1
+#define A10_GPIO_PULLDOWN	2
+
+/* External interrupt trigger modes */
+#define A10_GPIO_EINT_POS_EDGE	0
+#define A10_GPIO_EINT_NEG_EDGE	1
+#define A10_GPIO_EINT_HIGH	2
+#define A10_GPIO_EINT_LOW	3
+#define A10_GPIO_EINT_DBL_EDGE	4
+
+int a10_gpio_set_pin_func(uint32_t, uint32_t, uint32_t);
+int a10_gpio_eint_setup(uint32_t, uint32_t, void (*)(void *), void *);
+
+#endif /* _A10_GPIO_H_ */
@@ -0,0 +1,1607 @@
+/*-
+ * Copyright (c) 2026 agent <agent@local>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Allwinner A10 SD/MMC host controller.
+ *
+ * The controller is not SDHCI compatible, it is driven directly through
+ * the mmcbr interface.  Data moves through the internal DMA controller
+ * (IDMAC) using a chain of descriptors built from the busdma segments
+ * of the request buffer.
+ */
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include <sys/param.h>
+#include <sys/systm.h>
+#include <sys/bus.h>
+#include <sys/gpio.h>
+#include <sys/kernel.h>
+#include <sys/lock.h>
+#include <sys/malloc.h>
+#include <sys/module.h>
+#include <sys/mutex.h>
+#include <sys/resource.h>
+#include <sys/rman.h>
+#include <sys/sbuf.h>
+#include <sys/sysctl.h>
+#include <sys/taskqueue.h>
+#include <sys/time.h>
+
+#include <machine/bus.h>
+#include <machine/cpu.h>
+#include <machine/resource.h>
+#include <machine/intr.h>
+
+#include <dev/fdt/fdt_common.h>
+#include <dev/ofw/ofw_bus.h>
+#include <dev/ofw/ofw_bus_subr.h>
+
+#include <dev/mmc/bridge.h>
+#include <dev/mmc/mmcreg.h>
+#include <dev/mmc/mmcbrvar.h>
+
+#include <arm/allwinner/a10_clk.h>
+#include <arm/allwinner/a10_gpio.h>
+#include <arm/allwinner/a10_mmc.h>
+
+#include "gpio_if.h"
+#include "mmcbr_if.h"
+
+#define A10_MMC_MEMRES		0
+#define A10_MMC_IRQRES		1
+#define A10_MMC_RESSZ		2
+
+#define A10_MMC_BLOCK_SIZE	512
+#define A10_MMC_MAX_BLOCKS	0xffff	/* SET_BLOCK_COUNT argument */
+#define A10_MMC_DMA_MAXSIZE	MAXPHYS
+#define A10_MMC_DMA_SEGS	(A10_MMC_DMA_MAXSIZE / PAGE_SIZE + 1)
+
+#define A10_MMC_PRECMDS		3	/* APP_CMD, ACMD23, CMD23 */
+
+#define A10_MMC_RESET_RETRY	1000
+
+#define A10_MMC_IDLE_MS		100	/* gate the clocks after this long idle */
+
+/* Clock states, for the residency counters */
+#define A10_MMC_PWR_ACTIVE	0	/* host acquired by the mmc layer */
+#define A10_MMC_PWR_IDLE	1	/* released, clocks running */
+#define A10_MMC_PWR_GATED	2	/* card, module and AHB clocks off */
+#define A10_MMC_PWR_NSTATES	3
+
+/* Latency histogram bucket n counts requests under 2^n microseconds. */
+#define A10_MMC_LAT_BUCKETS	24
+#define A10_MMC_DEFAULT_CLK	24000000	/* module clock left by u-boot */
+#define A10_MMC_HS_CLK		50000000	/* SD high-speed */
+
+#define A10_MMC_NCTRL		4
+#define A10_MMC_BASE		0x01c0f000
+#define A10_MMC_STRIDE		0x1000
+#define A10_MMC_NPINS		6	/* CLK, CMD, D0-D3 */
+
+/* Pads of each controller: first pin and mux function. */
+static const struct {
+	uint32_t	pin;
+	uint32_t	func;
+} a10_mmc_pins[A10_MMC_NCTRL] = {
+	{ A10_GPIO_PIN(5, 0),	2 },	/* SDC0: PF0-PF5 */
+	{ A10_GPIO_PIN(6, 0),	4 },	/* SDC1: PG0-PG5 */
+	{ A10_GPIO_PIN(2, 6),	3 },	/* SDC2: PC6-PC11 */
+	{ A10_GPIO_PIN(8, 4),	2 },	/* SDC3: PI4-PI9 */
+};
+
+struct a10_mmc_softc {
+	device_t		sc_dev;
+	int			sc_id;		/* controller index, 0-3 */
+	struct mtx		sc_mtx;
+	struct resource *	sc_res[A10_MMC_RESSZ];
+	bus_space_tag_t		sc_bst;
+	bus_space_handle_t	sc_bsh;
+	void *			sc_intrhand;
+	struct callout		sc_timeoutc;
+	int			sc_timeout;
+	int			sc_bus_busy;
+	uint32_t		sc_mod_clk;
+	int			sc_ccm_clk;	/* module clock set by the CCM */
+	struct mmc_host		sc_host;
+	struct mmc_request *	sc_req;
+	struct mmc_command *	sc_curcmd;
+	uint32_t		sc_intr;
+	uint32_t		sc_intr_wait;
+	int			sc_resid;
+
+	/* Commands sent ahead of a multi-block transfer */
+	struct mmc_command	sc_precmd[A10_MMC_PRECMDS];
+	int			sc_nprecmd;
+	int			sc_precmd_next;
+	int			sc_sbc;
+	uint32_t		sc_rca;
+
+	/* IDMAC descriptor ring and data buffer map */
+	bus_dma_tag_t		sc_dma_tag;
+	bus_dmamap_t		sc_dma_map;
+	void *			sc_dma_desc;
+	bus_addr_t		sc_dma_desc_phys;
+	bus_dma_tag_t		sc_dma_buf_tag;
+	bus_dmamap_t		sc_dma_buf_map;
+	int			sc_dma_map_err;
+
+	/* Card detect and write protect GPIOs, -1 if not wired */
+	device_t		sc_gpio_dev;
+	int			sc_cd_pin;
+	int			sc_cd_inv;
+	int			sc_wp_pin;
+	int			sc_wp_inv;
+	device_t		sc_child;
+	struct timeout_task	sc_card_task;
+
+	/* Statistics, see a10_mmc_stats_sysctl() */
+	struct bintime		sc_req_start;
+	struct mmc_command *	sc_last_err;
+	uint32_t		sc_last_err_opcode;
+	uint32_t		sc_last_err_arg;
+	uint64_t		sc_st_cmds;
+	uint64_t		sc_st_rd_blocks;
+	uint64_t		sc_st_wr_blocks;
+	uint64_t		sc_st_rd_us;
+	uint64_t		sc_st_wr_us;
+	uint64_t		sc_st_crc_errs;
+	uint64_t		sc_st_timeouts;
+	uint64_t		sc_st_errs;
+	uint64_t		sc_st_retries;
+	uint64_t		sc_st_lat[A10_MMC_LAT_BUCKETS];
+
+	/* Idle clock gating */
+	struct callout		sc_idlec;
+	int			sc_idle_ms;	/* 0 disables gating */
+	int			sc_pwr_state;
+	struct bintime		sc_pwr_since;
+	struct bintime		sc_pwr_time[A10_MMC_PWR_NSTATES];
+	uint64_t		sc_pwr_ungates;
+};
+
+static struct resource_spec a10_mmc_res_spec[] = {
+	{ SYS_RES_MEMORY,	0,	RF_ACTIVE },
+	{ SYS_RES_IRQ,		0,	RF_ACTIVE | RF_SHAREABLE },
+	{ -1,			0,	0 }
+};
+
+/*
+ * Bound multi-block transfers with SET_BLOCK_COUNT (CMD23) instead of
+ * the controller auto-stop.  Not all SD cards implement CMD23, the SCR
+ * is not visible from here, so this is off by default.
+ */
+static int a10_mmc_cmd23 = 0;
+TUNABLE_INT("hw.a10_mmc.cmd23", &a10_mmc_cmd23);
+
+/* Send SET_WR_BLK_ERASE_COUNT (ACMD23) ahead of multi-block writes. */
+static int a10_mmc_pre_erase = 0;
+TUNABLE_INT("hw.a10_mmc.pre_erase", &a10_mmc_pre_erase);
+
+static SYSCTL_NODE(_hw, OID_AUTO, a10_mmc, CTLFLAG_RD, 0,
+    "A10 MMC");
+SYSCTL_INT(_hw_a10_mmc, OID_AUTO, cmd23, CTLFLAG_RW | CTLFLAG_TUN,
+    &a10_mmc_cmd23, 0, "Use SET_BLOCK_COUNT for multi-block transfers");
+SYSCTL_INT(_hw_a10_mmc, OID_AUTO, pre_erase, CTLFLAG_RW | CTLFLAG_TUN,
+    &a10_mmc_pre_erase, 0, "Send pre-erase hints before multi-block writes");
+
+static int a10_mmc_probe(device_t);
+static int a10_mmc_attach(device_t);
+static int a10_mmc_detach(device_t);
+static int a10_mmc_setup_dma(struct a10_mmc_softc *);
+static void a10_mmc_teardown_dma(struct a10_mmc_softc *);
+static int a10_mmc_setup_pins(struct a10_mmc_softc *);
+static int a10_mmc_setup_cd_wp(struct a10_mmc_softc *, phandle_t);
+static void a10_mmc_card_task(void *, int);
+static void a10_mmc_sysctl_init(struct a10_mmc_softc *);
+static void a10_mmc_idle_schedule(struct a10_mmc_softc *);
+static int a10_mmc_reset(struct a10_mmc_softc *);
+static void a10_mmc_intr(void *);
+static int a10_mmc_update_clock(struct a10_mmc_softc *, uint32_t);
+static void a10_mmc_next_cmd(struct a10_mmc_softc *);
+
+#define A10_MMC_LOCK(_sc)	mtx_lock(&(_sc)->sc_mtx)
+#define A10_MMC_UNLOCK(_sc)	mtx_unlock(&(_sc)->sc_mtx)
+#define A10_MMC_READ_4(_sc, _reg)					\
+	bus_space_read_4((_sc)->sc_bst, (_sc)->sc_bsh, _reg)
+#define A10_MMC_WRITE_4(_sc, _reg, _value)				\
+	bus_space_write_4((_sc)->sc_bst, (_sc)->sc_bsh, _reg, _value)
+
+static int
+a10_mmc_probe(device_t dev)
+{
+
+	if (!ofw_bus_is_compatible(dev, "allwinner,sun4i-mmc"))
+		return (ENXIO);
+	if (!fdt_is_enabled(ofw_bus_get_node(dev)))
+		return (ENXIO);
+
+	device_set_desc(dev, "Allwinner A10 MMC/SD controller");
+	return (BUS_PROBE_DEFAULT);
+}
+
+static int
+a10_mmc_attach(device_t dev)
+{
+	struct a10_mmc_softc *sc;
+	struct sysctl_ctx_list *ctx;
+	struct sysctl_oid_list *tree;
+	phandle_t node;
+	pcell_t cell;
+
+	sc = device_get_softc(dev);
+	sc->sc_dev = dev;
+	sc->sc_req = NULL;
+
+	if (bus_alloc_resources(dev, a10_mmc_res_spec, sc->sc_res) != 0) {
+		device_printf(dev, "cannot allocate device resources\n");
+		return (ENXIO);
+	}
+	sc->sc_bst = rman_get_bustag(sc->sc_res[A10_MMC_MEMRES]);
+	sc->sc_bsh = rman_get_bushandle(sc->sc_res[A10_MMC_MEMRES]);
+
+	/* The register window tells which of the controllers this is. */
+	sc->sc_id = (rman_get_start(sc->sc_res[A10_MMC_MEMRES]) -
+	    A10_MMC_BASE) / A10_MMC_STRIDE;
+	if (sc->sc_id < 0 || sc->sc_id >= A10_MMC_NCTRL) {
+		device_printf(dev, "unknown controller at 0x%lx\n",
+		    rman_get_start(sc->sc_res[A10_MMC_MEMRES]));
+		bus_release_resources(dev, a10_mmc_res_spec, sc->sc_res);
+		return (ENXIO);
+	}
+
+	mtx_init(&sc->sc_mtx, device_get_nameunit(dev), "a10_mmc", MTX_DEF);
+	callout_init_mtx(&sc->sc_timeoutc, &sc->sc_mtx, 0);
+	callout_init_mtx(&sc->sc_idlec, &sc->sc_mtx, 0);
+	sc->sc_pwr_state = A10_MMC_PWR_IDLE;
+	binuptime(&sc->sc_pwr_since);
+
+	if (bus_setup_intr(dev, sc->sc_res[A10_MMC_IRQRES],
+	    INTR_TYPE_MISC | INTR_MPSAFE, NULL, a10_mmc_intr, sc,
+	    &sc->sc_intrhand)) {
+		device_printf(dev, "cannot setup interrupt handler\n");
+		goto fail_mtx;
+	}
+
+	/* Gate the AHB and module clocks on. */
+	if (a10_clk_mmc_activate(sc->sc_id) != 0) {
+		device_printf(dev, "cannot activate mmc clock\n");
+		goto fail_intr;
+	}
+
+	if (a10_mmc_setup_pins(sc) != 0) {
+		device_printf(dev, "cannot mux the controller pins\n");
+		goto fail_clk;
+	}
+
+	sc->sc_mod_clk = A10_MMC_DEFAULT_CLK;
+	node = ofw_bus_get_node(dev);
+	if ((OF_getprop(node, "clock-frequency", &cell, sizeof(cell))) > 0)
+		sc->sc_mod_clk = fdt32_to_cpu(cell);
+
+	sc->sc_timeout = 10;
+	ctx = device_get_sysctl_ctx(dev);
+	tree = SYSCTL_CHILDREN(device_get_sysctl_tree(dev));
+	SYSCTL_ADD_INT(ctx, tree, OID_AUTO, "req_timeout", CTLFLAG_RW,
+	    &sc->sc_timeout, 0, "Request timeout in seconds");
+	sc->sc_idle_ms = A10_MMC_IDLE_MS;
+	SYSCTL_ADD_INT(ctx, tree, OID_AUTO, "idle_gate_ms", CTLFLAG_RW,
+	    &sc->sc_idle_ms, 0, "Gate the clocks after this many ms idle, "
+	    "0 to never gate");
+	a10_mmc_sysctl_init(sc);
+
+	if (a10_mmc_reset(sc) != 0) {
+		device_printf(dev, "cannot reset the controller\n");
+		goto fail_clk;
+	}
+
+	if (a10_mmc_setup_dma(sc) != 0) {
+		device_printf(dev, "cannot setup the DMA engine\n");
+		goto fail_dma;
+	}
+
+	/*
+	 * With PLL6 running the module clock can follow the card clock,
+	 * otherwise only the controller divider on the boot-time module
+	 * clock is available.
+	 */
+	sc->sc_ccm_clk = (a10_clk_pll6_get_rate() > 0);
+
+	sc->sc_host.f_min = 400000;
+	sc->sc_host.f_max = sc->sc_mod_clk;
+	sc->sc_host.host_ocr = MMC_OCR_320_330 | MMC_OCR_330_340;
+	sc->sc_host.caps = MMC_CAP_4_BIT_DATA;
+	if ((OF_getprop(node, "bus-width", &cell, sizeof(cell))) > 0 &&
+	    fdt32_to_cpu(cell) == 1)
+		sc->sc_host.caps &= ~MMC_CAP_4_BIT_DATA;
+	if (sc->sc_ccm_clk) {
+		sc->sc_host.f_max = A10_MMC_HS_CLK;
+		sc->sc_host.caps |= MMC_CAP_HSPEED;
+	}
+
+	TIMEOUT_TASK_INIT(taskqueue_swi_giant, &sc->sc_card_task, 0,
+	    a10_mmc_card_task, sc);
+	if (a10_mmc_setup_cd_wp(sc, node) != 0) {
+		device_printf(dev, "cannot setup card detect\n");
+		goto fail_task;
+	}
+
+	/* Attach the mmc bus now if a card is in the slot. */
+	a10_mmc_card_task(sc, 0);
+
+	A10_MMC_LOCK(sc);
+	a10_mmc_idle_schedule(sc);
+	A10_MMC_UNLOCK(sc);
+
+	return (0);
+
+fail_task:
+	taskqueue_drain_timeout(taskqueue_swi_giant, &sc->sc_card_task);
+fail_dma:
+	a10_mmc_teardown_dma(sc);
+fail_clk:
+	a10_clk_mmc_deactivate(sc->sc_id);
+fail_intr:
+	bus_teardown_intr(dev, sc->sc_res[A10_MMC_IRQRES], sc->sc_intrhand);
+	sc->sc_intrhand = NULL;
+fail_mtx:
+	callout_drain(&sc->sc_timeoutc);
+	callout_drain(&sc->sc_idlec);
+	mtx_destroy(&sc->sc_mtx);
+	bus_release_resources(dev, a10_mmc_res_spec, sc->sc_res);
+
+	return (ENXIO);
+}
+
+static int
+a10_mmc_setup_pins(struct a10_mmc_softc *sc)
+{
+	uint32_t pin;
+	int error, i;
+
+	pin = a10_mmc_pins[sc->sc_id].pin;
+	for (i = 0; i < A10_MMC_NPINS; i++) {
+		error = a10_gpio_set_pin_func(pin + i,
+		    a10_mmc_pins[sc->sc_id].func, A10_GPIO_PULLUP);
+		if (error != 0)
+			return (error);
+	}
+
+	return (0);
+}
+
+static int
+a10_mmc_get_gpio(phandle_t node, const char *name, int *pin, int *inv)
+{
+	pcell_t gpios[4];
+
+	/* <&GPIO bank pin flags>, flags bit 0 set for active low */
+	if (OF_getprop(node, name, gpios, sizeof(gpios)) != sizeof(gpios))
+		return (ENOENT);
+	*pin = A10_GPIO_PIN(fdt32_to_cpu(gpios[1]), fdt32_to_cpu(gpios[2]));
+	*inv = fdt32_to_cpu(gpios[3]) & 1;
+
+	return (0);
+}
+
+static int
+a10_mmc_gpio_active(struct a10_mmc_softc *sc, int pin, int inv)
+{
+	unsigned int val;
+
+	if (GPIO_PIN_GET(sc->sc_gpio_dev, pin, &val) != 0)
+		return (-1);
+
+	return ((val != 0) ^ inv);
+}
+
+static int
+a10_mmc_card_present(struct a10_mmc_softc *sc)
+{
+
+	/* Without a card detect line assume the slot is populated. */
+	if (sc->sc_cd_pin < 0)
+		return (1);
+
+	return (a10_mmc_gpio_active(sc, sc->sc_cd_pin, sc->sc_cd_inv) != 0);
+}
+
+static void
+a10_mmc_cd_intr(void *arg)
+{
+	struct a10_mmc_softc *sc;
+
+	sc = (struct a10_mmc_softc *)arg;
+
+	/* Let the contacts settle before looking at the slot. */
+	taskqueue_enqueue_timeout(taskqueue_swi_giant, &sc->sc_card_task,
+	    hz / 2);
+}
+
+static void
+a10_mmc_card_task(void *arg, int pending)
+{
+	struct a10_mmc_softc *sc;
+	device_t child;
+
+	sc = (struct a10_mmc_softc *)arg;
+	if (a10_mmc_card_present(sc)) {
+		if (sc->sc_child != NULL)
+			return;
+		child = device_add_child(sc->sc_dev, "mmc", -1);
+		if (child == NULL) {
+			device_printf(sc->sc_dev, "attaching MMC bus failed!\n");
+			return;
+		}
+		if (device_probe_and_attach(child) != 0) {
+			device_printf(sc->sc_dev,
+			    "attaching MMC child failed!\n");
+			device_delete_child(sc->sc_dev, child);
+			return;
+		}
+		sc->sc_child = child;
+	} else {
+		if (sc->sc_child == NULL)
+			return;
+		device_delete_child(sc->sc_dev, sc->sc_child);
+		sc->sc_child = NULL;
+	}
+}
+
+/*
+ * Card detect and write protect come from GPIOs described by the
+ * cd-gpios and wp-gpios properties.  Card detect uses a GPIO external
+ * interrupt on both edges, so insertion and removal attach and detach
+ * the mmc bus right away.
+ */
+static int
+a10_mmc_setup_cd_wp(struct a10_mmc_softc *sc, phandle_t node)
+{
+	int error;
+
+	sc->sc_cd_pin = -1;
+	sc->sc_wp_pin = -1;
+	a10_mmc_get_gpio(node, "cd-gpios", &sc->sc_cd_pin, &sc->sc_cd_inv);
+	a10_mmc_get_gpio(node, "wp-gpios", &sc->sc_wp_pin, &sc->sc_wp_inv);
+	if (sc->sc_cd_pin < 0 && sc->sc_wp_pin < 0)
+		return (0);
+
+	sc->sc_gpio_dev = devclass_get_device(devclass_find("gpio"), 0);
+	if (sc->sc_gpio_dev == NULL) {
+		device_printf(sc->sc_dev, "cannot find the GPIO device\n");
+		return (ENXIO);
+	}
+
+	if (sc->sc_wp_pin >= 0)
+		GPIO_PIN_SETFLAGS(sc->sc_gpio_dev, sc->sc_wp_pin,
+		    GPIO_PIN_INPUT | GPIO_PIN_PULLUP);
+	if (sc->sc_cd_pin >= 0) {
+		GPIO_PIN_SETFLAGS(sc->sc_gpio_dev, sc->sc_cd_pin,
+		    GPIO_PIN_INPUT | GPIO_PIN_PULLUP);
+		error = a10_gpio_eint_setup(sc->sc_cd_pin,
+		    A10_GPIO_EINT_DBL_EDGE, a10_mmc_cd_intr, sc);
+		if (error != 0)
+			return (error);
+	}
+
+	return (0);
+}
+
+static int
+a10_mmc_detach(device_t dev)
+{
+
+	return (EBUSY);
+}
+
+static void
+a10_dma_desc_cb(void *arg, bus_dma_segment_t *segs, int nsegs, int err)
+{
+	struct a10_mmc_softc *sc;
+
+	sc = (struct a10_mmc_softc *)arg;
+	if (err) {
+		sc->sc_dma_map_err = err;
+		return;
+	}
+	sc->sc_dma_desc_phys = segs[0].ds_addr;
+}
+
+static int
+a10_mmc_setup_dma(struct a10_mmc_softc *sc)
+{
+	int dma_desc_size, error;
+
+	/* Allocate the DMA descriptor memory. */
+	dma_desc_size = sizeof(struct a10_mmc_dma_desc) * A10_MMC_DMA_SEGS;
+	error = bus_dma_tag_create(bus_get_dma_tag(sc->sc_dev),
+	    A10_MMC_DMA_ALIGN, 0, BUS_SPACE_MAXADDR_32BIT, BUS_SPACE_MAXADDR,
+	    NULL, NULL, dma_desc_size, 1, dma_desc_size, 0, NULL, NULL,
+	    &sc->sc_dma_tag);
+	if (error)
+		return (error);
+	error = bus_dmamem_alloc(sc->sc_dma_tag, &sc->sc_dma_desc,
+	    BUS_DMA_WAITOK | BUS_DMA_ZERO | BUS_DMA_COHERENT,
+	    &sc->sc_dma_map);
+	if (error)
+		return (error);
+
+	error = bus_dmamap_load(sc->sc_dma_tag, sc->sc_dma_map,
+	    sc->sc_dma_desc, dma_desc_size, a10_dma_desc_cb, sc, 0);
+	if (error)
+		return (error);
+	if (sc->sc_dma_map_err)
+		return (sc->sc_dma_map_err);
+
+	/* Create the DMA map for data transfers. */
+	error = bus_dma_tag_create(bus_get_dma_tag(sc->sc_dev),
+	    A10_MMC_DMA_ALIGN, 0, BUS_SPACE_MAXADDR_32BIT, BUS_SPACE_MAXADDR,
+	    NULL, NULL, A10_MMC_DMA_MAXSIZE, A10_MMC_DMA_SEGS,
+	    A10_MMC_DMA_MAX_SIZE, BUS_DMA_ALLOCNOW, NULL, NULL,
+	    &sc->sc_dma_buf_tag);
+	if (error)
+		return (error);
+	error = bus_dmamap_create(sc->sc_dma_buf_tag, 0,
+	    &sc->sc_dma_buf_map);
+	if (error)
+		return (error);
+
+	return (0);
+}
+
+/* Undo whatever part of a10_mmc_setup_dma() got done. */
+static void
+a10_mmc_teardown_dma(struct a10_mmc_softc *sc)
+{
+
+	if (sc->sc_dma_buf_map != NULL) {
+		bus_dmamap_destroy(sc->sc_dma_buf_tag, sc->sc_dma_buf_map);
+		sc->sc_dma_buf_map = NULL;
+	}
+	if (sc->sc_dma_buf_tag != NULL) {
+		bus_dma_tag_destroy(sc->sc_dma_buf_tag);
+		sc->sc_dma_buf_tag = NULL;
+	}
+	if (sc->sc_dma_desc_phys != 0) {
+		bus_dmamap_unload(sc->sc_dma_tag, sc->sc_dma_map);
+		sc->sc_dma_desc_phys = 0;
+	}
+	if (sc->sc_dma_desc != NULL) {
+		bus_dmamem_free(sc->sc_dma_tag, sc->sc_dma_desc,
+		    sc->sc_dma_map);
+		sc->sc_dma_desc = NULL;
+	}
+	if (sc->sc_dma_tag != NULL) {
+		bus_dma_tag_destroy(sc->sc_dma_tag);
+		sc->sc_dma_tag = NULL;
+	}
+}
+
+static void
+a10_dma_cb(void *arg, bus_dma_segment_t *segs, int nsegs, int err)
+{
+	struct a10_mmc_dma_desc *dma_desc;
+	struct a10_mmc_softc *sc;
+	int i;
+
+	sc = (struct a10_mmc_softc *)arg;
+	sc->sc_dma_map_err = err;
+	if (err)
+		return;
+
+	/* One chained descriptor per segment, interrupt on the last. */
+	dma_desc = sc->sc_dma_desc;
+	for (i = 0; i < nsegs; i++) {
+		dma_desc[i].buf_size = segs[i].ds_len;
+		dma_desc[i].buf_addr = segs[i].ds_addr;
+		dma_desc[i].config = A10_MMC_DMA_CONFIG_CH |
+		    A10_MMC_DMA_CONFIG_OWN;
+		if (i == 0)
+			dma_desc[i].config |= A10_MMC_DMA_CONFIG_FD;
+		if (i < (nsegs - 1)) {
+			dma_desc[i].config |= A10_MMC_DMA_CONFIG_DIC;
+			dma_desc[i].next = sc->sc_dma_desc_phys +
+			    ((i + 1) * sizeof(struct a10_mmc_dma_desc));
+		} else {
+			dma_desc[i].config |= A10_MMC_DMA_CONFIG_LD |
+			    A10_MMC_DMA_CONFIG_ER;
+			dma_desc[i].next = 0;
+		}
+	}
+}
+
+static int
+a10_mmc_prepare_dma(struct a10_mmc_softc *sc)
+{
+	bus_dmasync_op_t sync_op;
+	struct mmc_command *cmd;
+	int error;
+	uint32_t val;
+
+	cmd = sc->sc_req->cmd;
+	if (cmd->data->len > A10_MMC_DMA_MAXSIZE)
+		return (EFBIG);
+	error = bus_dmamap_load(sc->sc_dma_buf_tag, sc->sc_dma_buf_map,
+	    cmd->data->data, cmd->data->len, a10_dma_cb, sc, BUS_DMA_NOWAIT);
+	if (error)
+		return (error);
+	if (sc->sc_dma_map_err)
+		return (sc->sc_dma_map_err);
+
+	if (cmd->data->flags & MMC_DATA_WRITE)
+		sync_op = BUS_DMASYNC_PREWRITE;
+	else
+		sync_op = BUS_DMASYNC_PREREAD;
+	bus_dmamap_sync(sc->sc_dma_buf_tag, sc->sc_dma_buf_map, sync_op);
+	bus_dmamap_sync(sc->sc_dma_tag, sc->sc_dma_map, BUS_DMASYNC_PREWRITE);
+
+	/* Route the FIFO to the DMA engine and reset it. */
+	val = A10_MMC_READ_4(sc, A10_MMC_GCTRL);
+	val &= ~A10_MMC_ACCESS_BY_AHB;
+	val |= A10_MMC_DMA_ENABLE | A10_MMC_DMA_RESET;
+	A10_MMC_WRITE_4(sc, A10_MMC_GCTRL, val);
+
+	A10_MMC_WRITE_4(sc, A10_MMC_DMAC, A10_MMC_IDMAC_SOFT_RST);
+	A10_MMC_WRITE_4(sc, A10_MMC_DMAC,
+	    A10_MMC_IDMAC_IDMA_ON | A10_MMC_IDMAC_FIX_BURST);
+
+	/* Enable the RX or TX completion interrupt. */
+	if (cmd->data->flags & MMC_DATA_WRITE)
+		val = A10_MMC_IDMAC_TX_INT;
+	else
+		val = A10_MMC_IDMAC_RX_INT;
+	A10_MMC_WRITE_4(sc, A10_MMC_IDIE, val | A10_MMC_IDMAC_ERROR);
+
+	/* Set the descriptor list address and the FIFO trigger level. */
+	A10_MMC_WRITE_4(sc, A10_MMC_DLBA, sc->sc_dma_desc_phys);
+	A10_MMC_WRITE_4(sc, A10_MMC_FTRGL, A10_MMC_DMA_FTRGLEVEL);
+
+	return (0);
+}
+
+static int
+a10_mmc_reset(struct a10_mmc_softc *sc)
+{
+	int timeout;
+
+	A10_MMC_WRITE_4(sc, A10_MMC_GCTRL,
+	    A10_MMC_READ_4(sc, A10_MMC_GCTRL) | A10_MMC_RESET);
+	timeout = A10_MMC_RESET_RETRY;
+	while (--timeout > 0) {
+		if ((A10_MMC_READ_4(sc, A10_MMC_GCTRL) & A10_MMC_RESET) == 0)
+			break;
+		DELAY(100);
+	}
+	if (timeout == 0)
+		return (ETIMEDOUT);
+
+	/* Set the timeout. */
+	A10_MMC_WRITE_4(sc, A10_MMC_TIMEOUT, 0xffffffff);
+
+	/* Clear pending interrupts. */
+	A10_MMC_WRITE_4(sc, A10_MMC_RINTR, 0xffffffff);
+	A10_MMC_WRITE_4(sc, A10_MMC_IDST, 0xffffffff);
+
+	/* Unmask interrupts. */
+	A10_MMC_WRITE_4(sc, A10_MMC_IMASK, A10_MMC_INT_ERR_BIT |
+	    A10_MMC_CMD_DONE | A10_MMC_DATA_OVER | A10_MMC_AUTOCMD_DONE);
+
+	/* Enable interrupts and AHB access. */
+	A10_MMC_WRITE_4(sc, A10_MMC_GCTRL,
+	    A10_MMC_READ_4(sc, A10_MMC_GCTRL) | A10_MMC_INT_ENABLE);
+
+	return (0);
+}
+
+static void
+a10_mmc_account(struct a10_mmc_softc *sc, struct mmc_command *cmd)
+{
+	struct bintime bt;
+	uint64_t us;
+	int bucket;
+
+	binuptime(&bt);
+	bintime_sub(&bt, &sc->sc_req_start);
+	us = (uint64_t)bt.sec * 1000000 +
+	    (((uint64_t)1000000 * (uint32_t)(bt.frac >> 32)) >> 32);
+	for (bucket = 0; bucket < A10_MMC_LAT_BUCKETS - 1; bucket++)
+		if (us < (1ULL << bucket))
+			break;
+	sc->sc_st_lat[bucket]++;
+
+	switch (cmd->error) {
+	case MMC_ERR_NONE:
+		sc->sc_last_err = NULL;
+		if (cmd->data == NULL)
+			break;
+		if (cmd->data->flags & MMC_DATA_WRITE) {
+			sc->sc_st_wr_blocks +=
+			    howmany(cmd->data->len, A10_MMC_BLOCK_SIZE);
+			sc->sc_st_wr_us += us;
+		} else {
+			sc->sc_st_rd_blocks +=
+			    howmany(cmd->data->len, A10_MMC_BLOCK_SIZE);
+			sc->sc_st_rd_us += us;
+		}
+		return;
+	case MMC_ERR_BADCRC:
+		sc->sc_st_crc_errs++;
+		break;
+	case MMC_ERR_TIMEOUT:
+		sc->sc_st_timeouts++;
+		break;
+	default:
+		sc->sc_st_errs++;
+		break;
+	}
+	sc->sc_last_err = cmd;
+	sc->sc_last_err_opcode = cmd->opcode;
+	sc->sc_last_err_arg = cmd->arg;
+}
+
+static void
+a10_mmc_req_done(struct a10_mmc_softc *sc)
+{
+	struct mmc_command *cmd;
+	struct mmc_request *req;
+	int retry;
+	uint32_t mask, val;
+
+	cmd = sc->sc_req->cmd;
+	if (cmd->error != MMC_ERR_NONE) {
+		/* Reset the FIFO and DMA engines. */
+		mask = A10_MMC_FIFO_RESET | A10_MMC_DMA_RESET;
+		val = A10_MMC_READ_4(sc, A10_MMC_GCTRL);
+		A10_MMC_WRITE_4(sc, A10_MMC_GCTRL, val | mask);
+
+		retry = A10_MMC_RESET_RETRY;
+		while (--retry > 0) {
+			val = A10_MMC_READ_4(sc, A10_MMC_GCTRL);
+			if ((val & mask) == 0)
+				break;
+			DELAY(10);
+		}
+		if (retry == 0)
+			device_printf(sc->sc_dev,
+			    "timeout resetting DMA/FIFO\n");
+		a10_mmc_update_clock(sc, 1);
+	}
+
+	if (cmd->data != NULL)
+		bus_dmamap_unload(sc->sc_dma_buf_tag, sc->sc_dma_buf_map);
+
+	a10_mmc_account(sc, cmd);
+	req = sc->sc_req;
+	callout_stop(&sc->sc_timeoutc);
+	sc->sc_req = NULL;
+	sc->sc_curcmd = NULL;
+	sc->sc_intr = 0;
+	sc->sc_resid = 0;
+	sc->sc_dma_map_err = 0;
+	sc->sc_intr_wait = 0;
+	req->done(req);
+}
+
+static void
+a10_mmc_req_ok(struct a10_mmc_softc *sc)
+{
+	struct mmc_command *cmd;
+	int timeout;
+	uint32_t status;
+
+	/* Wait for the card to leave the busy state. */
+	timeout = 1000;
+	while (--timeout > 0) {
+		status = A10_MMC_READ_4(sc, A10_MMC_STAS);
+		if ((status & A10_MMC_CARD_DATA_BUSY) == 0)
+			break;
+		DELAY(1000);
+	}
+	if (timeout == 0) {
+		sc->sc_req->cmd->error = MMC_ERR_FAILED;
+		a10_mmc_req_done(sc);
+		return;
+	}
+	cmd = sc->sc_curcmd;
+	if (cmd->flags & MMC_RSP_PRESENT) {
+		if (cmd->flags & MMC_RSP_136) {
+			cmd->resp[0] = A10_MMC_READ_4(sc, A10_MMC_RESP3);
+			cmd->resp[1] = A10_MMC_READ_4(sc, A10_MMC_RESP2);
+			cmd->resp[2] = A10_MMC_READ_4(sc, A10_MMC_RESP1);
+			cmd->resp[3] = A10_MMC_READ_4(sc, A10_MMC_RESP0);
+		} else
+			cmd->resp[0] = A10_MMC_READ_4(sc, A10_MMC_RESP0);
+	}
+	if (cmd != sc->sc_req->cmd) {
+		/* A prefix command went through, carry on. */
+		a10_mmc_next_cmd(sc);
+		return;
+	}
+	/* All data has been transferred ? */
+	if (cmd->data != NULL && sc->sc_resid != cmd->data->len)
+		cmd->error = MMC_ERR_FAILED;
+	a10_mmc_req_done(sc);
+}
+
+static void
+a10_mmc_timeout(void *arg)
+{
+	struct a10_mmc_softc *sc;
+
+	sc = (struct a10_mmc_softc *)arg;
+	if (sc->sc_req != NULL) {
+		device_printf(sc->sc_dev, "controller timeout\n");
+		sc->sc_req->cmd->error = MMC_ERR_TIMEOUT;
+		a10_mmc_req_done(sc);
+	} else
+		device_printf(sc->sc_dev,
+		    "Spurious timeout - no active request\n");
+}
+
+static void
+a10_mmc_intr(void *arg)
+{
+	bus_dmasync_op_t sync_op;
+	struct a10_mmc_softc *sc;
+	struct mmc_data *data;
+	uint32_t idst, rint;
+
+	sc = (struct a10_mmc_softc *)arg;
+	A10_MMC_LOCK(sc);
+	/* Registers are not reachable with the AHB clock gated. */
+	if (sc->sc_pwr_state == A10_MMC_PWR_GATED) {
+		A10_MMC_UNLOCK(sc);
+		return;
+	}
+	rint = A10_MMC_READ_4(sc, A10_MMC_RINTR);
+	idst = A10_MMC_READ_4(sc, A10_MMC_IDST);
+	if (idst == 0 && rint == 0) {
+		A10_MMC_UNLOCK(sc);
+		return;
+	}
+	/*
+	 * Acknowledge before acting on the status: finishing a prefix
+	 * command starts the next one, and a later write-back of these
+	 * values would clear its CMD_DONE/DATA_OVER.
+	 */
+	A10_MMC_WRITE_4(sc, A10_MMC_IDST, idst);
+	A10_MMC_WRITE_4(sc, A10_MMC_RINTR, rint);
+
+	if (sc->sc_req == NULL) {
+		device_printf(sc->sc_dev,
+		    "Spurious interrupt - no active request, rint: 0x%08X\n",
+		    rint);
+		goto end;
+	}
+	if (rint & A10_MMC_INT_ERR_BIT) {
+		if (bootverbose)
+			device_printf(sc->sc_dev, "error rint: 0x%08X\n", rint);
+		if (rint & A10_MMC_RESP_TIMEOUT)
+			sc->sc_req->cmd->error = MMC_ERR_TIMEOUT;
+		else if (rint & (A10_MMC_RESP_CRC_ERR | A10_MMC_DATA_CRC_ERR))
+			sc->sc_req->cmd->error = MMC_ERR_BADCRC;
+		else
+			sc->sc_req->cmd->error = MMC_ERR_FAILED;
+		a10_mmc_req_done(sc);
+		goto end;
+	}
+	if (idst & A10_MMC_IDMAC_ERROR) {
+		device_printf(sc->sc_dev, "error idst: 0x%08x\n", idst);
+		sc->sc_req->cmd->error = MMC_ERR_FAILED;
+		a10_mmc_req_done(sc);
+		goto end;
+	}
+
+	sc->sc_intr |= rint;
+	data = sc->sc_curcmd->data;
+	if (data != NULL && (idst & A10_MMC_IDMAC_COMPLETE) != 0) {
+		if (data->flags & MMC_DATA_WRITE)
+			sync_op = BUS_DMASYNC_POSTWRITE;
+		else
+			sync_op = BUS_DMASYNC_POSTREAD;
+		bus_dmamap_sync(sc->sc_dma_buf_tag, sc->sc_dma_buf_map,
+		    sync_op);
+		bus_dmamap_sync(sc->sc_dma_tag, sc->sc_dma_map,
+		    BUS_DMASYNC_POSTWRITE);
+		sc->sc_resid = data->len;
+	}
+	if ((sc->sc_intr & sc->sc_intr_wait) == sc->sc_intr_wait &&
+	    (data == NULL || sc->sc_resid == data->len))
+		a10_mmc_req_ok(sc);
+
+end:
+	A10_MMC_UNLOCK(sc);
+}
+
+static void
+a10_mmc_start_cmd(struct a10_mmc_softc *sc, struct mmc_command *cmd)
+{
+	uint32_t blksz, cmdreg;
+
+	sc->sc_curcmd = cmd;
+	cmdreg = A10_MMC_START;
+	if (cmd->opcode == MMC_GO_IDLE_STATE)
+		cmdreg |= A10_MMC_SEND_INIT_SEQ;
+	if (cmd->flags & MMC_RSP_PRESENT)
+		cmdreg |= A10_MMC_RESP_EXP;
+	if (cmd->flags & MMC_RSP_136)
+		cmdreg |= A10_MMC_LONG_RESP;
+	if (cmd->flags & MMC_RSP_CRC)
+		cmdreg |= A10_MMC_CHECK_RESP_CRC;
+
+	sc->sc_intr = 0;
+	sc->sc_resid = 0;
+	sc->sc_intr_wait = A10_MMC_CMD_DONE;
+	cmd->error = MMC_ERR_NONE;
+	if (cmd->data != NULL) {
+		sc->sc_intr_wait |= A10_MMC_DATA_OVER;
+		cmdreg |= A10_MMC_DATA_EXP | A10_MMC_WAIT_PREOVER;
+		/*
+		 * Unless the block count was set up front, let the
+		 * controller issue the STOP_TRANSMISSION itself at the end
+		 * of a multi-block transfer, req->stop is then already
+		 * taken care of when the request completes.
+		 */
+		if ((cmd->data->flags & MMC_DATA_MULTI) && !sc->sc_sbc) {
+			cmdreg |= A10_MMC_SEND_AUTOSTOP;
+			sc->sc_intr_wait |= A10_MMC_AUTOCMD_DONE;
+		}
+		if (cmd->data->flags & MMC_DATA_WRITE)
+			cmdreg |= A10_MMC_WRITE;
+		blksz = min(cmd->data->len, A10_MMC_BLOCK_SIZE);
+		A10_MMC_WRITE_4(sc, A10_MMC_BLKSZ, blksz);
+		A10_MMC_WRITE_4(sc, A10_MMC_BCNTR, cmd->data->len);
+	}
+
+	A10_MMC_WRITE_4(sc, A10_MMC_CARG, cmd->arg);
+	A10_MMC_WRITE_4(sc, A10_MMC_CMDR, cmdreg | cmd->opcode);
+}
+
+static void
+a10_mmc_next_cmd(struct a10_mmc_softc *sc)
+{
+
+	if (sc->sc_precmd_next < sc->sc_nprecmd)
+		a10_mmc_start_cmd(sc, &sc->sc_precmd[sc->sc_precmd_next++]);
+	else
+		a10_mmc_start_cmd(sc, sc->sc_req->cmd);
+}
+
+static void
+a10_mmc_add_precmd(struct a10_mmc_softc *sc, uint32_t opcode, uint32_t arg)
+{
+	struct mmc_command *pcmd;
+
+	pcmd = &sc->sc_precmd[sc->sc_nprecmd++];
+	memset(pcmd, 0, sizeof(*pcmd));
+	pcmd->opcode = opcode;
+	pcmd->arg = arg;
+	pcmd->flags = MMC_RSP_R1 | MMC_CMD_AC;
+}
+
+static int
+a10_mmc_request(device_t bus, device_t child, struct mmc_request *req)
+{
+	struct a10_mmc_softc *sc;
+	struct mmc_command *cmd;
+	uint32_t nblocks;
+	int err;
+
+	sc = device_get_softc(bus);
+	A10_MMC_LOCK(sc);
+	if (sc->sc_req) {
+		A10_MMC_UNLOCK(sc);
+		return (EBUSY);
+	}
+	sc->sc_req = req;
+	cmd = req->cmd;
+	binuptime(&sc->sc_req_start);
+	sc->sc_st_cmds++;
+
+	/* The mmc layer retries by handing the failed command back. */
+	if (sc->sc_last_err == cmd && sc->sc_last_err_opcode == cmd->opcode &&
+	    sc->sc_last_err_arg == cmd->arg)
+		sc->sc_st_retries++;
+
+	/*
+	 * Remember the RCA of an SD card from its APP_CMDs, ACMD23 needs
+	 * one.  MMC cards never see an APP_CMD with a non-zero RCA.
+	 */
+	if (cmd->opcode == MMC_GO_IDLE_STATE)
+		sc->sc_rca = 0;
+	else if (cmd->opcode == MMC_APP_CMD && (cmd->arg >> 16) != 0)
+		sc->sc_rca = cmd->arg >> 16;
+
+	sc->sc_nprecmd = 0;
+	sc->sc_precmd_next = 0;
+	sc->sc_sbc = 0;
+	if (cmd->data != NULL && (cmd->data->flags & MMC_DATA_MULTI)) {
+		nblocks = cmd->data->len / A10_MMC_BLOCK_SIZE;
+		if (a10_mmc_pre_erase && sc->sc_rca != 0 &&
+		    (cmd->data->flags & MMC_DATA_WRITE)) {
+			a10_mmc_add_precmd(sc, MMC_APP_CMD, sc->sc_rca << 16);
+			a10_mmc_add_precmd(sc, ACMD_SET_WR_BLK_ERASE_COUNT,
+			    nblocks);
+		}
+		if (a10_mmc_cmd23) {
+			a10_mmc_add_precmd(sc, MMC_SET_BLOCK_COUNT, nblocks);
+			sc->sc_sbc = 1;
+		}
+	}
+
+	if (cmd->data != NULL) {
+		err = a10_mmc_prepare_dma(sc);
+		if (err != 0) {
+			device_printf(sc->sc_dev, "prepare_dma failed: %d\n",
+			    err);
+			cmd->error = MMC_ERR_NO_MEMORY;
+			a10_mmc_req_done(sc);
+			A10_MMC_UNLOCK(sc);
+			return (0);
+		}
+	}
+
+	a10_mmc_next_cmd(sc);
+	callout_reset(&sc->sc_timeoutc, sc->sc_timeout * hz,
+	    a10_mmc_timeout, sc);
+	A10_MMC_UNLOCK(sc);
+
+	return (0);
+}
+
+/*
+ * The counters are 64 bits wide and updated under sc_mtx; reading them
+ * through a plain UQUAD could tear on 32-bit ARM.
+ */
+static int
+a10_mmc_stat_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_mmc_softc *sc;
+	uint64_t val;
+
+	sc = arg1;
+	A10_MMC_LOCK(sc);
+	val = *(uint64_t *)((char *)sc + arg2);
+	A10_MMC_UNLOCK(sc);
+
+	return (sysctl_handle_64(oidp, &val, 0, req));
+}
+
+static int
+a10_mmc_bps_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_mmc_softc *sc;
+	uint64_t blocks, bps, us;
+
+	sc = arg1;
+	A10_MMC_LOCK(sc);
+	if (arg2 == MMC_DATA_WRITE) {
+		blocks = sc->sc_st_wr_blocks;
+		us = sc->sc_st_wr_us;
+	} else {
+		blocks = sc->sc_st_rd_blocks;
+		us = sc->sc_st_rd_us;
+	}
+	A10_MMC_UNLOCK(sc);
+	bps = 0;
+	if (us != 0)
+		bps = blocks * A10_MMC_BLOCK_SIZE * 1000000 / us;
+
+	return (sysctl_handle_64(oidp, &bps, 0, req));
+}
+
+static int
+a10_mmc_lat_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_mmc_softc *sc;
+	uint64_t lat[A10_MMC_LAT_BUCKETS];
+	struct sbuf *sb;
+	int error, i;
+
+	sc = arg1;
+	A10_MMC_LOCK(sc);
+	memcpy(lat, sc->sc_st_lat, sizeof(lat));
+	A10_MMC_UNLOCK(sc);
+
+	sb = sbuf_new_for_sysctl(NULL, NULL, 512, req);
+	if (sb == NULL)
+		return (ENOMEM);
+	for (i = 0; i < A10_MMC_LAT_BUCKETS; i++) {
+		if (lat[i] == 0)
+			continue;
+		if (i == A10_MMC_LAT_BUCKETS - 1)
+			sbuf_printf(sb, "\n  >= %10juus: %ju",
+			    (uintmax_t)1 << (i - 1), (uintmax_t)lat[i]);
+		else
+			sbuf_printf(sb, "\n  < %11juus: %ju",
+			    (uintmax_t)1 << i, (uintmax_t)lat[i]);
+	}
+	error = sbuf_finish(sb);
+	sbuf_delete(sb);
+
+	return (error);
+}
+
+static int
+a10_mmc_stats_reset_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_mmc_softc *sc;
+	int error, val;
+
+	val = 0;
+	error = sysctl_handle_int(oidp, &val, 0, req);
+	if (error != 0 || req->newptr == NULL || val == 0)
+		return (error);
+
+	sc = arg1;
+	A10_MMC_LOCK(sc);
+	sc->sc_st_cmds = 0;
+	sc->sc_st_rd_blocks = sc->sc_st_wr_blocks = 0;
+	sc->sc_st_rd_us = sc->sc_st_wr_us = 0;
+	sc->sc_st_crc_errs = sc->sc_st_timeouts = sc->sc_st_errs = 0;
+	sc->sc_st_retries = 0;
+	memset(sc->sc_st_lat, 0, sizeof(sc->sc_st_lat));
+	A10_MMC_UNLOCK(sc);
+
+	return (0);
+}
+
+static int
+a10_mmc_pwr_sysctl(SYSCTL_HANDLER_ARGS)
+{
+	struct a10_mmc_softc *sc;
+	struct bintime bt, now;
+	uint64_t ms;
+
+	sc = arg1;
+	A10_MMC_LOCK(sc);
+	bt = sc->sc_pwr_time[arg2];
+	if (sc->sc_pwr_state == arg2) {
+		binuptime(&now);
+		bintime_sub(&now, &sc->sc_pwr_since);
+		bintime_add(&bt, &now);
+	}
+	A10_MMC_UNLOCK(sc);
+	ms = (uint64_t)bt.sec * 1000 +
+	    (((uint64_t)1000 * (uint32_t)(bt.frac >> 32)) >> 32);
+
+	return (sysctl_handle_64(oidp, &ms, 0, req));
+}
+
+static void
+a10_mmc_sysctl_init(struct a10_mmc_softc *sc)
+{
+	struct sysctl_ctx_list *ctx;
+	struct sysctl_oid_list *tree;
+	struct sysctl_oid *node;
+
+	ctx = device_get_sysctl_ctx(sc->sc_dev);
+	tree = SYSCTL_CHILDREN(device_get_sysctl_tree(sc->sc_dev));
+	node = SYSCTL_ADD_NODE(ctx, tree, OID_AUTO, "stats", CTLFLAG_RD,
+	    NULL, "Transfer statistics");
+	tree = SYSCTL_CHILDREN(node);
+
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "cmds",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_mmc_softc, sc_st_cmds),
+	    a10_mmc_stat_sysctl, "QU", "Requests issued");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "read_blocks",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_mmc_softc, sc_st_rd_blocks),
+	    a10_mmc_stat_sysctl, "QU", "Blocks read");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "write_blocks",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_mmc_softc, sc_st_wr_blocks),
+	    a10_mmc_stat_sysctl, "QU", "Blocks written");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "read_bps",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc, MMC_DATA_READ, a10_mmc_bps_sysctl,
+	    "QU", "Read throughput while busy, bytes per second");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "write_bps",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc, MMC_DATA_WRITE, a10_mmc_bps_sysctl,
+	    "QU", "Write throughput while busy, bytes per second");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "crc_errors",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_mmc_softc, sc_st_crc_errs),
+	    a10_mmc_stat_sysctl, "QU", "CRC errors");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "timeouts",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_mmc_softc, sc_st_timeouts),
+	    a10_mmc_stat_sysctl, "QU", "Timeouts");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "errors",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_mmc_softc, sc_st_errs),
+	    a10_mmc_stat_sysctl, "QU", "Other errors");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "retries",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_mmc_softc, sc_st_retries),
+	    a10_mmc_stat_sysctl, "QU",
+	    "Failed commands retried by the mmc layer");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "latency",
+	    CTLTYPE_STRING | CTLFLAG_RD, sc, 0, a10_mmc_lat_sysctl, "A",
+	    "Request to completion latency histogram");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "reset",
+	    CTLTYPE_INT | CTLFLAG_RW, sc, 0, a10_mmc_stats_reset_sysctl, "I",
+	    "Clear the statistics");
+
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "active_ms",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc, A10_MMC_PWR_ACTIVE,
+	    a10_mmc_pwr_sysctl, "QU", "Time spent with the host acquired");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "idle_ms",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc, A10_MMC_PWR_IDLE,
+	    a10_mmc_pwr_sysctl, "QU", "Time spent idle with clocks running");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "gated_ms",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc, A10_MMC_PWR_GATED,
+	    a10_mmc_pwr_sysctl, "QU", "Time spent with the clocks gated");
+	SYSCTL_ADD_PROC(ctx, tree, OID_AUTO, "ungates",
+	    CTLTYPE_U64 | CTLFLAG_RD, sc,
+	    __offsetof(struct a10_mmc_softc, sc_pwr_ungates),
+	    a10_mmc_stat_sysctl, "QU", "Clock ungate events");
+}
+
+static int
+a10_mmc_read_ivar(device_t bus, device_t child, int which,
+    uintptr_t *result)
+{
+	struct a10_mmc_softc *sc;
+
+	sc = device_get_softc(bus);
+	switch (which) {
+	default:
+		return (EINVAL);
+	case MMCBR_IVAR_BUS_MODE:
+		*(int *)result = sc->sc_host.ios.bus_mode;
+		break;
+	case MMCBR_IVAR_BUS_WIDTH:
+		*(int *)result = sc->sc_host.ios.bus_width;
+		break;
+	case MMCBR_IVAR_CHIP_SELECT:
+		*(int *)result = sc->sc_host.ios.chip_select;
+		break;
+	case MMCBR_IVAR_CLOCK:
+		*(int *)result = sc->sc_host.ios.clock;
+		break;
+	case MMCBR_IVAR_F_MIN:
+		*(int *)result = sc->sc_host.f_min;
+		break;
+	case MMCBR_IVAR_F_MAX:
+		*(int *)result = sc->sc_host.f_max;
+		break;
+	case MMCBR_IVAR_HOST_OCR:
+		*(int *)result = sc->sc_host.host_ocr;
+		break;
+	case MMCBR_IVAR_MODE:
+		*(int *)result = sc->sc_host.mode;
+		break;
+	case MMCBR_IVAR_OCR:
+		*(int *)result = sc->sc_host.ocr;
+		break;
+	case MMCBR_IVAR_POWER_MODE:
+		*(int *)result = sc->sc_host.ios.power_mode;
+		break;
+	case MMCBR_IVAR_VDD:
+		*(int *)result = sc->sc_host.ios.vdd;
+		break;
+	case MMCBR_IVAR_CAPS:
+		*(int *)result = sc->sc_host.caps;
+		break;
+	case MMCBR_IVAR_TIMING:
+		*(int *)result = sc->sc_host.ios.timing;
+		break;
+	case MMCBR_IVAR_MAX_DATA:
+		*(int *)result = min(A10_MMC_DMA_MAXSIZE / A10_MMC_BLOCK_SIZE,
+		    A10_MMC_MAX_BLOCKS);
+		break;
+	}
+
+	return (0);
+}
+
+static int
+a10_mmc_write_ivar(device_t bus, device_t child, int which,
+    uintptr_t value)
+{
+	struct a10_mmc_softc *sc;
+
+	sc = device_get_softc(bus);
+	switch (which) {
+	default:
+		return (EINVAL);
+	case MMCBR_IVAR_BUS_MODE:
+		sc->sc_host.ios.bus_mode = value;
+		break;
+	case MMCBR_IVAR_BUS_WIDTH:
+		sc->sc_host.ios.bus_width = value;
+		break;
+	case MMCBR_IVAR_CHIP_SELECT:
+		sc->sc_host.ios.chip_select = value;
+		break;
+	case MMCBR_IVAR_CLOCK:
+		sc->sc_host.ios.clock = value;
+		break;
+	case MMCBR_IVAR_MODE:
+		sc->sc_host.mode = value;
+		break;
+	case MMCBR_IVAR_OCR:
+		sc->sc_host.ocr = value;
+		break;
+	case MMCBR_IVAR_POWER_MODE:
+		sc->sc_host.ios.power_mode = value;
+		break;
+	case MMCBR_IVAR_VDD:
+		sc->sc_host.ios.vdd = value;
+		break;
+	case MMCBR_IVAR_TIMING:
+		sc->sc_host.ios.timing = value;
+		break;
+	/* These are read-only */
+	case MMCBR_IVAR_CAPS:
+	case MMCBR_IVAR_HOST_OCR:
+	case MMCBR_IVAR_F_MIN:
+	case MMCBR_IVAR_F_MAX:
+	case MMCBR_IVAR_MAX_DATA:
+		return (EINVAL);
+	}
+
+	return (0);
+}
+
+static int
+a10_mmc_update_clock(struct a10_mmc_softc *sc, uint32_t clkon)
+{
+	uint32_t clkcr, cmdreg;
+	int retry;
+
+	clkcr = A10_MMC_READ_4(sc, A10_MMC_CLKCR);
+	if (clkon)
+		clkcr |= A10_MMC_CARD_CLK_ON;
+	else
+		clkcr &= ~A10_MMC_CARD_CLK_ON;
+	A10_MMC_WRITE_4(sc, A10_MMC_CLKCR, clkcr);
+
+	/* Have the card interface pick up the new clock settings. */
+	cmdreg = A10_MMC_START | A10_MMC_UPCLK_ONLY | A10_MMC_WAIT_PREOVER;
+	A10_MMC_WRITE_4(sc, A10_MMC_CMDR, cmdreg);
+	retry = 0xfffff;
+	while (--retry > 0) {
+		if ((A10_MMC_READ_4(sc, A10_MMC_CMDR) & A10_MMC_START) == 0) {
+			A10_MMC_WRITE_4(sc, A10_MMC_RINTR, 0xffffffff);
+			return (0);
+		}
+		DELAY(10);
+	}
+	A10_MMC_WRITE_4(sc, A10_MMC_RINTR, 0xffffffff);
+	device_printf(sc->sc_dev, "timeout updating clock\n");
+
+	return (ETIMEDOUT);
+}
+
+static int
+a10_mmc_update_ios(device_t bus, device_t child)
+{
+	struct a10_mmc_softc *sc;
+	struct mmc_ios *ios;
+	uint32_t clkcr, div;
+	int error, rate;
+
+	sc = device_get_softc(bus);
+	ios = &sc->sc_host.ios;
+
+	/* Set the bus width. */
+	switch (ios->bus_width) {
+	case bus_width_1:
+		A10_MMC_WRITE_4(sc, A10_MMC_WIDTH, A10_MMC_WIDTH1);
+		break;
+	case bus_width_4:
+		A10_MMC_WRITE_4(sc, A10_MMC_WIDTH, A10_MMC_WIDTH4);
+		break;
+	case bus_width_8:
+		A10_MMC_WRITE_4(sc, A10_MMC_WIDTH, A10_MMC_WIDTH8);
+		break;
+	}
+
+	/* Stop the card clock while the divider changes. */
+	error = a10_mmc_update_clock(sc, 0);
+	if (error != 0 || ios->clock == 0)
+		return (error);
+
+	/* Run the module clock at the card clock if the CCM allows it. */
+	if (sc->sc_ccm_clk) {
+		rate = a10_clk_mmc_cfg(sc->sc_id, ios->clock);
+		if (rate > 0)
+			sc->sc_mod_clk = rate;
+	}
+
+	/* Card clock is module clock / (2 * div), div 0 bypasses it. */
+	div = 0;
+	if (ios->clock < sc->sc_mod_clk)
+		div = howmany(sc->sc_mod_clk, 2 * ios->clock);
+	clkcr = A10_MMC_READ_4(sc, A10_MMC_CLKCR);
+	clkcr &= ~A10_MMC_CLKCR_DIV;
+	clkcr |= min(div, A10_MMC_CLKCR_DIV);
+	A10_MMC_WRITE_4(sc, A10_MMC_CLKCR, clkcr);
+
+	return (a10_mmc_update_clock(sc, 1));
+}
+
+static int
+a10_mmc_get_ro(device_t bus, device_t child)
+{
+	struct a10_mmc_softc *sc;
+
+	sc = device_get_softc(bus);
+	if (sc->sc_wp_pin < 0)
+		return (0);
+
+	return (a10_mmc_gpio_active(sc, sc->sc_wp_pin, sc->sc_wp_inv) == 1);
+}
+
+static void
+a10_mmc_pwr_state(struct a10_mmc_softc *sc, int state)
+{
+	struct bintime bt, now;
+
+	binuptime(&now);
+	bt = now;
+	bintime_sub(&bt, &sc->sc_pwr_since);
+	bintime_add(&sc->sc_pwr_time[sc->sc_pwr_state], &bt);
+	sc->sc_pwr_since = now;
+	sc->sc_pwr_state = state;
+}
+
+/*
+ * The card clock may be stopped between commands, so once the mmc
+ * layer has released the host for sc_idle_ms the card clock, the
+ * module clock and the AHB clock are all gated off.  The next
+ * acquire_host turns them back on before any request is issued.
+ */
+static void
+a10_mmc_idle(void *arg)
+{
+	struct a10_mmc_softc *sc;
+
+	sc = (struct a10_mmc_softc *)arg;
+	if (sc->sc_bus_busy != 0 || sc->sc_pwr_state != A10_MMC_PWR_IDLE)
+		return;
+	if (a10_mmc_update_clock(sc, 0) != 0)
+		return;
+	if (a10_clk_mmc_deactivate(sc->sc_id) != 0) {
+		a10_mmc_update_clock(sc, 1);
+		return;
+	}
+	a10_mmc_pwr_state(sc, A10_MMC_PWR_GATED);
+}
+
+static void
+a10_mmc_idle_schedule(struct a10_mmc_softc *sc)
+{
+
+	if (sc->sc_idle_ms > 0)
+		callout_reset(&sc->sc_idlec,
+		    max(1, (sc->sc_idle_ms * hz) / 1000), a10_mmc_idle, sc);
+}
+
+/*
+ * mmc(4) ignores the return value of acquire_host, so failing to turn
+ * the clocks back on is logged rather than returned.  If the module
+ * clocks stay off the host stays GATED and the next acquire tries
+ * again; a card clock that does not restart leaves the module clocks
+ * on and is retried by the next update_ios.
+ */
+static void
+a10_mmc_ungate(struct a10_mmc_softc *sc)
+{
+	int error;
+
+	if (sc->sc_pwr_state != A10_MMC_PWR_GATED)
+		return;
+	error = a10_clk_mmc_activate(sc->sc_id);
+	if (error != 0) {
+		device_printf(sc->sc_dev, "cannot ungate mmc clock (%d)\n",
+		    error);
+		return;
+	}
+	sc->sc_pwr_ungates++;
+	a10_mmc_pwr_state(sc, A10_MMC_PWR_ACTIVE);
+	if (sc->sc_host.ios.clock != 0)
+		a10_mmc_update_clock(sc, 1);
+}
+
+static int
+a10_mmc_acquire_host(device_t bus, device_t child)
+{
+	struct a10_mmc_softc *sc;
+
+	sc = device_get_softc(bus);
+	A10_MMC_LOCK(sc);
+	/* As in sdhci(4), waiting for the bus is not interruptible. */
+	while (sc->sc_bus_busy)
+		msleep(sc, &sc->sc_mtx, 0, "mmchw", 0);
+	sc->sc_bus_busy++;
+	callout_stop(&sc->sc_idlec);
+	a10_mmc_ungate(sc);
+	if (sc->sc_pwr_state == A10_MMC_PWR_IDLE)
+		a10_mmc_pwr_state(sc, A10_MMC_PWR_ACTIVE);
+	A10_MMC_UNLOCK(sc);
+
+	return (0);
+}
+
+static int
+a10_mmc_release_host(device_t bus, device_t child)
+{
+	struct a10_mmc_softc *sc;
+
+	sc = device_get_softc(bus);
+	A10_MMC_LOCK(sc);
+	KASSERT(sc->sc_bus_busy > 0,
+	    ("%s: host released but not acquired", __func__));
+	sc->sc_bus_busy--;
+	if (sc->sc_bus_busy == 0 && sc->sc_pwr_state == A10_MMC_PWR_ACTIVE) {
+		a10_mmc_pwr_state(sc, A10_MMC_PWR_IDLE);
+		a10_mmc_idle_schedule(sc);
+	}
+	wakeup(sc);
+	A10_MMC_UNLOCK(sc);
+
+	return (0);
+}
+
+static device_method_t a10_mmc_methods[] = {
+	/* Device interface */
+	DEVMETHOD(device_probe,		a10_mmc_probe),
+	DEVMETHOD(device_attach,	a10_mmc_attach),
+	DEVMETHOD(device_detach,	a10_mmc_detach),
+
+	/* Bus interface */
+	DEVMETHOD(bus_read_ivar,	a10_mmc_read_ivar),
+	DEVMETHOD(bus_write_ivar,	a10_mmc_write_ivar),
+	DEVMETHOD(bus_print_child,	bus_generic_print_child),
+
+	/* MMC bridge interface */
+	DEVMETHOD(mmcbr_update_ios,	a10_mmc_update_ios),
+	DEVMETHOD(mmcbr_request,	a10_mmc_request),
+	DEVMETHOD(mmcbr_get_ro,		a10_mmc_get_ro),
+	DEVMETHOD(mmcbr_acquire_host,	a10_mmc_acquire_host),
+	DEVMETHOD(mmcbr_release_host,	a10_mmc_release_host),
+
+	DEVMETHOD_END
+};
+
+static devclass_t a10_mmc_devclass;
+
+static driver_t a10_mmc_driver = {
+	"a10_mmc",
+	a10_mmc_methods,
+	sizeof(struct a10_mmc_softc),
+};
+
+DRIVER_MODULE(a10_mmc, simplebus, a10_mmc_driver, a10_mmc_devclass, 0, 0);
+
+extern driver_t mmc_driver;
+extern devclass_t mmc_devclass;
+DRIVER_MODULE(mmc, a10_mmc, mmc_driver, mmc_devclass, NULL, NULL);
+MODULE_DEPEND(a10_mmc, mmc, 1, 1, 1);
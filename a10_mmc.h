@@ -0,0 +1,180 @@
+/*-
+ * Copyright (c) 2026 agent <agent@local>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _A10_MMC_H_
+#define _A10_MMC_H_
+
+#define A10_MMC_GCTRL		0x00	/* Global control */
+#define A10_MMC_CLKCR		0x04	/* Clock control */
+#define A10_MMC_TIMEOUT		0x08	/* Timeout */
+#define A10_MMC_WIDTH		0x0c	/* Bus width */
+#define A10_MMC_BLKSZ		0x10	/* Block size */
+#define A10_MMC_BCNTR		0x14	/* Byte count */
+#define A10_MMC_CMDR		0x18	/* Command */
+#define A10_MMC_CARG		0x1c	/* Command argument */
+#define A10_MMC_RESP0		0x20	/* Response 0 */
+#define A10_MMC_RESP1		0x24	/* Response 1 */
+#define A10_MMC_RESP2		0x28	/* Response 2 */
+#define A10_MMC_RESP3		0x2c	/* Response 3 */
+#define A10_MMC_IMASK		0x30	/* Interrupt mask */
+#define A10_MMC_MISTA		0x34	/* Masked interrupt status */
+#define A10_MMC_RINTR		0x38	/* Raw interrupt status */
+#define A10_MMC_STAS		0x3c	/* Status */
+#define A10_MMC_FTRGL		0x40	/* FIFO threshold watermark */
+#define A10_MMC_FUNS		0x44	/* Function select */
+#define A10_MMC_CBCR		0x48	/* CIU byte count */
+#define A10_MMC_BBCR		0x4c	/* BIU byte count */
+#define A10_MMC_DBGC		0x50	/* Debug enable */
+#define A10_MMC_DMAC		0x80	/* IDMAC control */
+#define A10_MMC_DLBA		0x84	/* IDMAC descriptor list base */
+#define A10_MMC_IDST		0x88	/* IDMAC status */
+#define A10_MMC_IDIE		0x8c	/* IDMAC interrupt enable */
+#define A10_MMC_CHDA		0x90	/* Current host descriptor */
+#define A10_MMC_CBDA		0x94	/* Current buffer descriptor */
+#define A10_MMC_FIFO		0x100	/* FIFO access */
+
+/* A10_MMC_GCTRL */
+#define A10_MMC_SOFT_RESET	(1U << 0)
+#define A10_MMC_FIFO_RESET	(1U << 1)
+#define A10_MMC_DMA_RESET	(1U << 2)
+#define A10_MMC_INT_ENABLE	(1U << 4)
+#define A10_MMC_DMA_ENABLE	(1U << 5)
+#define A10_MMC_DEBOUNCE_ENABLE	(1U << 8)
+#define A10_MMC_DDR_MODE	(1U << 10)
+#define A10_MMC_ACCESS_BY_AHB	(1U << 31)
+#define A10_MMC_RESET		\
+	(A10_MMC_SOFT_RESET | A10_MMC_FIFO_RESET | A10_MMC_DMA_RESET)
+
+/* A10_MMC_CLKCR */
+#define A10_MMC_CARD_CLK_ON	(1U << 16)
+#define A10_MMC_LOW_POWER_ON	(1U << 17)
+#define A10_MMC_CLKCR_DIV	0xff
+
+/* A10_MMC_WIDTH */
+#define A10_MMC_WIDTH1		0
+#define A10_MMC_WIDTH4		1
+#define A10_MMC_WIDTH8		2
+
+/* A10_MMC_CMDR */
+#define A10_MMC_RESP_EXP	(1U << 6)
+#define A10_MMC_LONG_RESP	(1U << 7)
+#define A10_MMC_CHECK_RESP_CRC	(1U << 8)
+#define A10_MMC_DATA_EXP	(1U << 9)
+#define A10_MMC_WRITE		(1U << 10)
+#define A10_MMC_SEQ_MODE	(1U << 11)
+#define A10_MMC_SEND_AUTOSTOP	(1U << 12)
+#define A10_MMC_WAIT_PREOVER	(1U << 13)
+#define A10_MMC_STOP_ABORT_CMD	(1U << 14)
+#define A10_MMC_SEND_INIT_SEQ	(1U << 15)
+#define A10_MMC_UPCLK_ONLY	(1U << 21)
+#define A10_MMC_RDCEATADEV	(1U << 22)
+#define A10_MMC_CCS_EXP		(1U << 23)
+#define A10_MMC_ENB_BOOT	(1U << 24)
+#define A10_MMC_ALT_BOOT_OPT	(1U << 25)
+#define A10_MMC_BOOT_ACK_EXP	(1U << 26)
+#define A10_MMC_DISABLE_BOOT	(1U << 27)
+#define A10_MMC_VOL_SWITCH	(1U << 28)
+#define A10_MMC_START		(1U << 31)
+
+/* A10_MMC_IMASK, A10_MMC_MISTA and A10_MMC_RINTR */
+#define A10_MMC_RESP_ERR	(1U << 1)
+#define A10_MMC_CMD_DONE	(1U << 2)
+#define A10_MMC_DATA_OVER	(1U << 3)
+#define A10_MMC_TX_DATA_REQ	(1U << 4)
+#define A10_MMC_RX_DATA_REQ	(1U << 5)
+#define A10_MMC_RESP_CRC_ERR	(1U << 6)
+#define A10_MMC_DATA_CRC_ERR	(1U << 7)
+#define A10_MMC_RESP_TIMEOUT	(1U << 8)
+#define A10_MMC_DATA_TIMEOUT	(1U << 9)
+#define A10_MMC_DATA_STARVE	(1U << 10)
+#define A10_MMC_FIFO_RUN_ERR	(1U << 11)
+#define A10_MMC_HARDWARE_LOCKED	(1U << 12)
+#define A10_MMC_START_BIT_ERR	(1U << 13)
+#define A10_MMC_AUTOCMD_DONE	(1U << 14)
+#define A10_MMC_END_BIT_ERR	(1U << 15)
+#define A10_MMC_SDIO_INT	(1U << 16)
+#define A10_MMC_CARD_INSERT	(1U << 30)
+#define A10_MMC_CARD_REMOVE	(1U << 31)
+#define A10_MMC_INT_ERR_BIT	\
+	(A10_MMC_RESP_ERR | A10_MMC_RESP_CRC_ERR | A10_MMC_DATA_CRC_ERR | \
+	 A10_MMC_RESP_TIMEOUT | A10_MMC_DATA_TIMEOUT | A10_MMC_FIFO_RUN_ERR | \
+	 A10_MMC_HARDWARE_LOCKED | A10_MMC_START_BIT_ERR | A10_MMC_END_BIT_ERR)
+
+/* A10_MMC_STAS */
+#define A10_MMC_RX_WLFLAG	(1U << 0)
+#define A10_MMC_TX_WLFLAG	(1U << 1)
+#define A10_MMC_FIFO_EMPTY	(1U << 2)
+#define A10_MMC_FIFO_FULL	(1U << 3)
+#define A10_MMC_CARD_PRESENT	(1U << 8)
+#define A10_MMC_CARD_DATA_BUSY	(1U << 9)
+#define A10_MMC_DATA_FSM_BUSY	(1U << 10)
+
+/* A10_MMC_FTRGL: burst of 8 transfers, RX level 7, TX level 8 */
+#define A10_MMC_DMA_FTRGLEVEL	0x20070008
+
+/* A10_MMC_DMAC */
+#define A10_MMC_IDMAC_SOFT_RST	(1U << 0)
+#define A10_MMC_IDMAC_FIX_BURST	(1U << 1)
+#define A10_MMC_IDMAC_IDMA_ON	(1U << 7)
+#define A10_MMC_IDMAC_REFETCH_DES (1U << 31)
+
+/* A10_MMC_IDST and A10_MMC_IDIE */
+#define A10_MMC_IDMAC_TX_INT	(1U << 0)
+#define A10_MMC_IDMAC_RX_INT	(1U << 1)
+#define A10_MMC_IDMAC_FATAL_BUS_ERR (1U << 2)
+#define A10_MMC_IDMAC_DES_INVALID (1U << 4)
+#define A10_MMC_IDMAC_CARD_ERR_SUM (1U << 5)
+#define A10_MMC_IDMAC_NORMAL_INT_SUM (1U << 8)
+#define A10_MMC_IDMAC_ABNORMAL_INT_SUM (1U << 9)
+#define A10_MMC_IDMAC_ERROR	\
+	(A10_MMC_IDMAC_FATAL_BUS_ERR | A10_MMC_IDMAC_DES_INVALID | \
+	 A10_MMC_IDMAC_CARD_ERR_SUM | A10_MMC_IDMAC_ABNORMAL_INT_SUM)
+#define A10_MMC_IDMAC_COMPLETE	\
+	(A10_MMC_IDMAC_TX_INT | A10_MMC_IDMAC_RX_INT)
+
+/* IDMAC descriptor, chained mode */
+struct a10_mmc_dma_desc {
+	uint32_t	config;
+#define A10_MMC_DMA_CONFIG_DIC	(1U << 1)	/* no completion interrupt */
+#define A10_MMC_DMA_CONFIG_LD	(1U << 2)	/* last descriptor */
+#define A10_MMC_DMA_CONFIG_FD	(1U << 3)	/* first descriptor */
+#define A10_MMC_DMA_CONFIG_CH	(1U << 4)	/* chained */
+#define A10_MMC_DMA_CONFIG_ER	(1U << 5)	/* end of ring */
+#define A10_MMC_DMA_CONFIG_CES	(1U << 30)	/* card error summary */
+#define A10_MMC_DMA_CONFIG_OWN	(1U << 31)	/* owned by the IDMAC */
+	uint32_t	buf_size;
+	uint32_t	buf_addr;
+	uint32_t	next;
+};
+
+/* Descriptors and data buffers must be 32-bit aligned. */
+#define A10_MMC_DMA_ALIGN	4
+/* A10 descriptors carry a 13-bit buffer size. */
+#define A10_MMC_DMA_MAX_SIZE	0x2000
+
+#endif /* _A10_MMC_H_ */
@@ -68,6 +68,8 @@ __FBSDID("$FreeBSD$");
 #include <dev/sdhci/sdhci.h>
 #include "sdhci_if.h"
 
+#include "a10_sdhci_shadow.h"
+
 #define A10_SDHCI_CTRL_REG	0x00
 #define A10_SDHCI_INT_EN	(1 << 4)
 #define A10_SDHCI_POSELATCH	(1 << 9)
@@ -112,6 +114,7 @@ struct a10_sdhci_softc {
 	int			sc_xfer_done;
 	int			sc_bus_busy;
 	struct sdhci_slot	sc_slot;
+	struct a10_sdhci_shadow	sc_sh;	/* see a10_sdhci_shadow.h */
 };
 
 #define SD_MAX_BLOCKSIZE	1024
@@ -264,42 +267,41 @@ RD4(struct a10_sdhci_softc *sc, bus_size_t off)
 	return val;
 }
 
+/*
+ * Register writes are posted; a write barrier keeps them ordered with
+ * respect to whatever access follows.  Reading a register back until
+ * it matches is not a valid completion test here: INT_STATUS is
+ * write-1-to-clear, SOFTWARE_RESET (in the CLOCK_CONTROL word) is
+ * self-clearing, BLOCK_COUNT is decremented by the controller and
+ * writing COMMAND starts the transfer, so none of them reads back
+ * what was written.
+ */
 static inline void
 WR4(struct a10_sdhci_softc *sc, bus_size_t off, uint32_t val)
 {
-	bus_space_write_4(sc->sc_bst, sc->sc_bsh, off, val);
 
-	if ((off != SDHCI_BUFFER && off != SDHCI_INT_STATUS && off != SDHCI_CLOCK_CONTROL))
-	{
-		int timeout = 100000;
-		while (val != bus_space_read_4(sc->sc_bst, sc->sc_bsh, off) 
-		    && --timeout > 0)
-			continue;
-
-		if (timeout <= 0)
-			printf("a10_sdhci: writing 0x%X to reg 0x%X "
-				"always gives 0x%X\n",
-				val, (uint32_t)off, 
-				bus_space_read_4(sc->sc_bst, sc->sc_bsh, off));
-	}
+	bus_space_write_4(sc->sc_bst, sc->sc_bsh, off, val);
+	bus_space_barrier(sc->sc_bst, sc->sc_bsh, off, 4,
+	    BUS_SPACE_BARRIER_WRITE);
 }
 
+#define A10_SDHCI_SHADOW_FUNCS
+#include "a10_sdhci_shadow.h"
+
 static uint8_t
 a10_sdhci_read_1(device_t dev, struct sdhci_slot *slot, bus_size_t off)
 {
 	struct a10_sdhci_softc *sc = device_get_softc(dev);
-	uint32_t val = RD4(sc, off & ~3);
 
-	return ((val >> (off & 3)*8) & 0xff);
+	return (a10_sdhci_get_1(sc, off));
 }
 
 static uint16_t
 a10_sdhci_read_2(device_t dev, struct sdhci_slot *slot, bus_size_t off)
 {
 	struct a10_sdhci_softc *sc = device_get_softc(dev);
-	uint32_t val = RD4(sc, off & ~3);
 
-	return ((val >> (off & 3)*8) & 0xffff);
+	return (a10_sdhci_get_2(sc, off));
 }
 
 static uint32_t
@@ -307,7 +309,7 @@ a10_sdhci_read_4(device_t dev, struct sdhci_slot *slot, bus_size_t off)
 {
 	struct a10_sdhci_softc *sc = device_get_softc(dev);
 
-	return RD4(sc, off);
+	return (a10_sdhci_rd(sc, off));
 }
 
 static void
@@ -316,6 +318,7 @@ a10_sdhci_read_multi_4(device_t dev, struct sdhci_slot *slot, bus_size_t off,
 {
 	struct a10_sdhci_softc *sc = device_get_softc(dev);
 
+	a10_sdhci_flush(sc);
 	bus_space_read_multi_4(sc->sc_bst, sc->sc_bsh, off, data, count);
 }
 
@@ -323,35 +326,24 @@ static void
 a10_sdhci_write_1(device_t dev, struct sdhci_slot *slot, bus_size_t off, uint8_t val)
 {
 	struct a10_sdhci_softc *sc = device_get_softc(dev);
-	uint32_t val32 = RD4(sc, off & ~3);
-	val32 &= ~(0xff << (off & 3)*8);
-	val32 |= (val << (off & 3)*8);
-	WR4(sc, off & ~3, val32);
+
+	a10_sdhci_put_1(sc, off, val);
 }
 
 static void
 a10_sdhci_write_2(device_t dev, struct sdhci_slot *slot, bus_size_t off, uint16_t val)
 {
 	struct a10_sdhci_softc *sc = device_get_softc(dev);
-	static uint32_t cmd_and_transfer_mode;
-	uint32_t val32;
-	if (off == SDHCI_COMMAND_FLAGS)
-		val32 = cmd_and_transfer_mode;
-	else
-		val32 = RD4(sc, off & ~3);
-	val32 &= ~(0xffff << (off & 3)*8);
-	val32 |= (val << (off & 3)*8);
-	if (off == SDHCI_TRANSFER_MODE)
-		cmd_and_transfer_mode = val32;
-	else
-		WR4(sc, off & ~3, val32);
+
+	a10_sdhci_put_2(sc, off, val);
 }
 
 static void
 a10_sdhci_write_4(device_t dev, struct sdhci_slot *slot, bus_size_t off, uint32_t val)
 {
 	struct a10_sdhci_softc *sc = device_get_softc(dev);
-	WR4(sc, off, val);
+
+	a10_sdhci_put_4(sc, off, val);
 }
 
 static void
@@ -360,6 +352,7 @@ a10_sdhci_write_multi_4(device_t dev, struct sdhci_slot *slot, bus_size_t off,
 {
 	struct a10_sdhci_softc *sc = device_get_softc(dev);
 
+	a10_sdhci_flush(sc);
 	bus_space_write_multi_4(sc->sc_bst, sc->sc_bsh, off, data, count);
 }
 
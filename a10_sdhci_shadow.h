@@ -0,0 +1,212 @@
+/*-
+ * Copyright (c) 2026 agent <agent@local>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Register accessors for the SDHCI block of the A10, which only takes
+ * 32-bit accesses.  Narrow writes become read-modify-writes of their
+ * word; the TRANSFER_MODE, HOST_CONTROL, INT_ENABLE and SIGNAL_ENABLE
+ * words only change when the host writes them, so they are kept in a
+ * shadow and never read back, and TRANSFER_MODE and BLOCK_SIZE are held
+ * until the other half of their word is written.
+ *
+ * Shared by a10_sdhci1.c and tools/a10_sdhci_model.  The first include
+ * provides struct a10_sdhci_shadow, which goes into the includer's
+ * struct a10_sdhci_softc as sc_sh.  Including it again with
+ * A10_SDHCI_SHADOW_FUNCS defined provides the accessors; by then the
+ * softc and RD4(sc, off) and WR4(sc, off, val), which do the actual bus
+ * accesses, must be defined.
+ */
+
+#ifndef _A10_SDHCI_SHADOW_H_
+#define _A10_SDHCI_SHADOW_H_
+
+#define A10_SDHCI_NSHADOW	((SDHCI_SIGNAL_ENABLE >> 2) + 1)
+#define A10_SDHCI_SHADOWED						\
+	((1 << (SDHCI_TRANSFER_MODE >> 2)) |				\
+	 (1 << (SDHCI_HOST_CONTROL >> 2)) |				\
+	 (1 << (SDHCI_INT_ENABLE >> 2)) |				\
+	 (1 << (SDHCI_SIGNAL_ENABLE >> 2)))
+
+struct a10_sdhci_shadow {
+	/* Register words only the host writes, see a10_sdhci_rd() */
+	uint32_t	shadow[A10_SDHCI_NSHADOW];
+	uint32_t	shadow_valid;
+
+	/* Half-word write held back until the rest of its word arrives */
+	int		wc_pending;
+	bus_size_t	wc_off;
+	uint32_t	wc_mask;
+	uint32_t	wc_val;
+};
+
+#endif /* _A10_SDHCI_SHADOW_H_ */
+
+#if defined(A10_SDHCI_SHADOW_FUNCS) && !defined(_A10_SDHCI_SHADOW_FUNCS_)
+#define _A10_SDHCI_SHADOW_FUNCS_
+
+static __inline int
+a10_sdhci_shadowed(bus_size_t off)
+{
+
+	return (off < A10_SDHCI_NSHADOW * 4 &&
+	    (A10_SDHCI_SHADOWED & (1 << (off >> 2))) != 0);
+}
+
+static __inline uint32_t
+a10_sdhci_rd(struct a10_sdhci_softc *sc, bus_size_t off)
+{
+	struct a10_sdhci_shadow *sh = &sc->sc_sh;
+	uint32_t val;
+
+	off &= ~3;
+	if (a10_sdhci_shadowed(off) &&
+	    (sh->shadow_valid & (1 << (off >> 2))) != 0)
+		val = sh->shadow[off >> 2];
+	else {
+		val = RD4(sc, off);
+		if (a10_sdhci_shadowed(off)) {
+			sh->shadow[off >> 2] = val;
+			sh->shadow_valid |= (1 << (off >> 2));
+		}
+	}
+	if (sh->wc_pending && sh->wc_off == off)
+		val = (val & ~sh->wc_mask) | sh->wc_val;
+
+	return (val);
+}
+
+static __inline void
+a10_sdhci_wr(struct a10_sdhci_softc *sc, bus_size_t off, uint32_t val)
+{
+	struct a10_sdhci_shadow *sh = &sc->sc_sh;
+
+	WR4(sc, off, val);
+	if (a10_sdhci_shadowed(off)) {
+		sh->shadow[off >> 2] = val;
+		sh->shadow_valid |= (1 << (off >> 2));
+	}
+}
+
+/*
+ * Write the bits in mask of the word at off, together with any held
+ * back half-word of the same word.  Only a partial word costs a read,
+ * and write-1-to-clear status bits outside mask are written as zero so
+ * that no unseen interrupt gets acknowledged.
+ */
+static void
+a10_sdhci_merge(struct a10_sdhci_softc *sc, bus_size_t off, uint32_t mask,
+    uint32_t val)
+{
+	struct a10_sdhci_shadow *sh = &sc->sc_sh;
+	uint32_t word;
+
+	off &= ~3;
+	if (sh->wc_pending) {
+		if (sh->wc_off != off)
+			a10_sdhci_merge(sc, sh->wc_off, 0, 0);
+		else {
+			sh->wc_pending = 0;
+			val |= sh->wc_val & ~mask;
+			mask |= sh->wc_mask;
+		}
+	}
+	if (mask == 0xffffffff)
+		word = val;
+	else if (off == SDHCI_INT_STATUS)
+		word = val;
+	else
+		word = (a10_sdhci_rd(sc, off) & ~mask) | val;
+	a10_sdhci_wr(sc, off, word);
+}
+
+/* Called before the FIFO accessors, which bypass all of the above. */
+static __inline void
+a10_sdhci_flush(struct a10_sdhci_softc *sc)
+{
+
+	if (sc->sc_sh.wc_pending)
+		a10_sdhci_merge(sc, sc->sc_sh.wc_off, 0, 0);
+}
+
+static __inline uint8_t
+a10_sdhci_get_1(struct a10_sdhci_softc *sc, bus_size_t off)
+{
+	uint32_t val = a10_sdhci_rd(sc, off);
+
+	return ((val >> (off & 3)*8) & 0xff);
+}
+
+static __inline uint16_t
+a10_sdhci_get_2(struct a10_sdhci_softc *sc, bus_size_t off)
+{
+	uint32_t val = a10_sdhci_rd(sc, off);
+
+	return ((val >> (off & 3)*8) & 0xffff);
+}
+
+static __inline void
+a10_sdhci_put_1(struct a10_sdhci_softc *sc, bus_size_t off, uint8_t val)
+{
+
+	a10_sdhci_merge(sc, off, 0xffU << (off & 3)*8,
+	    (uint32_t)val << (off & 3)*8);
+	if (off == SDHCI_SOFTWARE_RESET)
+		sc->sc_sh.shadow_valid = 0;
+}
+
+static __inline void
+a10_sdhci_put_2(struct a10_sdhci_softc *sc, bus_size_t off, uint16_t val)
+{
+	struct a10_sdhci_shadow *sh = &sc->sc_sh;
+
+	/*
+	 * TRANSFER_MODE and BLOCK_SIZE are always followed by the other
+	 * half of their word (COMMAND, BLOCK_COUNT); hold them back so
+	 * that the pair goes out as a single write, which for COMMAND
+	 * is also what starts the transfer.
+	 */
+	if (off == SDHCI_TRANSFER_MODE || off == SDHCI_BLOCK_SIZE) {
+		a10_sdhci_flush(sc);
+		sh->wc_off = off & ~3;
+		sh->wc_mask = 0xffffU << (off & 3)*8;
+		sh->wc_val = (uint32_t)val << (off & 3)*8;
+		sh->wc_pending = 1;
+		return;
+	}
+	a10_sdhci_merge(sc, off, 0xffffU << (off & 3)*8,
+	    (uint32_t)val << (off & 3)*8);
+}
+
+static __inline void
+a10_sdhci_put_4(struct a10_sdhci_softc *sc, bus_size_t off, uint32_t val)
+{
+
+	a10_sdhci_merge(sc, off, 0xffffffff, val);
+}
+
+#endif /* A10_SDHCI_SHADOW_FUNCS */
@@ -30,10 +30,13 @@ __FBSDID("$FreeBSD: head/sys/arm/allwinner/timer.c 245900 2013-01-25 07:21:22Z g
 #include <sys/param.h>
 #include <sys/systm.h>
 #include <sys/bus.h>
+#include <sys/cpu.h>
+#include <sys/eventhandler.h>
 #include <sys/kernel.h>
 #include <sys/module.h>
 #include <sys/malloc.h>
 #include <sys/rman.h>
+#include <sys/sysctl.h>
 #include <sys/timeet.h>
 #include <sys/timetc.h>
 #include <sys/watchdog.h>
@@ -61,6 +64,12 @@ __FBSDID("$FreeBSD: head/sys/arm/allwinner/timer.c 245900 2013-01-25 07:21:22Z g
 #define SW_TIMER0_CTRL_REG 	0x10
 #define SW_TIMER0_INT_VALUE_REG	0x14
 #define SW_TIMER0_CUR_VALUE_REG	0x18
+#define SW_TIMER1_CTRL_REG 	0x20
+#define SW_TIMER1_INT_VALUE_REG	0x24
+#define SW_TIMER1_CUR_VALUE_REG	0x28
+#define SW_TIMER_CTRL_REG(n)		(0x10 + 0x10 * (n))
+#define SW_TIMER_INT_VALUE_REG(n)	(0x14 + 0x10 * (n))
+#define SW_TIMER_CUR_VALUE_REG(n)	(0x18 + 0x10 * (n))
 
 #define SW_COUNTER64LO_REG	0xa4
 #define SW_COUNTER64HI_REG	0xa8
@@ -69,21 +78,58 @@ __FBSDID("$FreeBSD: head/sys/arm/allwinner/timer.c 245900 2013-01-25 07:21:22Z g
 #define CNT64_RL_EN		0x02 /* read latch enable */
 
 #define TIMER_ENABLE		(1<<0)
-#define TIMER_AUTORELOAD	(1<<1)
+#define TIMER_RELOAD		(1<<1) /* load interval into current value */
+#define TIMER_CLKSRC_MASK	(3<<2)
 #define TIMER_OSC24M		(1<<2) /* oscillator = 24mhz */
-#define TIMER_PRESCALAR		(4<<4) /* prescalar = 16 */
+#define TIMER_PRESCALAR_MASK	(7<<4)
+#define TIMER_PRESCALAR(x)	((x)<<4) /* prescalar = 1 << x */
+#define TIMER_ONESHOT		(1<<7) /* single mode, else continuous */
+
+#define TIMER_ET_PRESCALE	0 /* no pre-division, 24mhz */
+
+/*
+ * A reload or disable only takes effect after a couple of cycles of
+ * the timer clock, count them on the free-running timer1.
+ */
+#define TIMER_SYNC_TICKS	3
+#define TIMER_MIN_TICKS		5
 
 #define SYS_TIMER_CLKSRC	24000000 /* clock source */
 
+/* Cortex-A8 performance monitor, CP15 c9 */
+#define PMCR_E			(1<<0) /* enable all counters */
+#define PMCR_C			(1<<2) /* reset cycle counter */
+#define PMCR_D			(1<<3) /* cycle counter counts every 64th */
+#define PMCNTEN_CCNT		(1U<<31) /* cycle counter enable */
+
+#define PMU_CALIBRATE_US	10000
+
+/*
+ * Timer0 drives hardclock.  Timer2 and timer4 are registered as spare
+ * event timers with a low quality so kern_clocksource leaves them
+ * alone; drivers that need precise one-shot deadlines can claim them
+ * through et_find()/et_init() by name.  Timer1 is the timecounter.
+ */
+#define A10_TIMER_ET_NUM	3
+
+struct a10_timer_softc;
+
+struct a10_timer_et {
+	struct a10_timer_softc *sc;
+	int		timer;		/* hardware timer number */
+	void 		*ih;		/* interrupt handler */
+	struct eventtimer et;
+};
+
 struct a10_timer_softc {
 	device_t 	sc_dev;
-	struct resource *res[2];
+	struct resource *res[1 + A10_TIMER_ET_NUM];
 	bus_space_tag_t sc_bst;
 	bus_space_handle_t sc_bsh;
-	void 		*sc_ih;		/* interrupt handler */
-	uint32_t 	sc_period;
 	uint32_t 	timer0_freq;
-	struct eventtimer et;
+	uint32_t 	timer1_freq;
+	uint32_t 	timer1_ticks_per_us;
+	struct a10_timer_et sc_et[A10_TIMER_ET_NUM];
 };
 
 int a10_timer_get_timerfreq(struct a10_timer_softc *);
@@ -94,33 +140,86 @@ int a10_timer_get_timerfreq(struct a10_timer_softc *);
 	bus_space_write_4(sc->sc_bst, sc->sc_bsh, reg, val)
 
 static u_int	a10_timer_get_timecount(struct timecounter *);
+static u_int	a10_timer1_get_timecount(struct timecounter *);
 static int	a10_timer_timer_start(struct eventtimer *,
     struct bintime *, struct bintime *);
 static int	a10_timer_timer_stop(struct eventtimer *);
 
 static uint64_t timer_read_counter64(void);
+static void	a10_timer_sync(struct a10_timer_softc *);
+
+static u_int	a10_pmu_get_timecount(struct timecounter *);
+static void	a10_pmu_init(struct a10_timer_softc *);
+static void	a10_pmu_freq_changed(void *, const struct cf_level *, int);
+
+static int a10_timer_et_attach(struct a10_timer_softc *, int);
 
 static int a10_timer_initialized = 0;
 static int a10_timer_hardclock(void *);
 static int a10_timer_probe(device_t);
 static int a10_timer_attach(device_t);
 
+/*
+ * The latched 64-bit counter costs several register accesses per read,
+ * keep it only as a fallback for the free-running timer1.
+ */
 static struct timecounter a10_timer_timecounter = {
-	.tc_name           = "a10_timer timer0",
+	.tc_name           = "a10_timer cnt64",
 	.tc_get_timecount  = a10_timer_get_timecount,
 	.tc_counter_mask   = ~0u,
 	.tc_frequency      = 0,
+	.tc_quality        = 500,
+};
+
+static struct timecounter a10_timer1_timecounter = {
+	.tc_name           = "a10_timer timer1",
+	.tc_get_timecount  = a10_timer1_get_timecount,
+	.tc_counter_mask   = ~0u,
+	.tc_frequency      = 0,
 	.tc_quality        = 1000,
 };
 
+/*
+ * The cycle counter is a single CP15 read but it follows the CPU clock
+ * and stops in WFI, so it is never picked automatically.  It has to be
+ * selected through kern.timecounter.hardware.
+ */
+static struct timecounter a10_pmu_timecounter = {
+	.tc_name           = "ARM PMU CCNT",
+	.tc_get_timecount  = a10_pmu_get_timecount,
+	.tc_counter_mask   = ~0u,
+	.tc_frequency      = 0,
+	.tc_quality        = -100,
+};
+
+static int a10_timer_pmu_enabled = 1;
+TUNABLE_INT("hw.a10_timer.pmu", &a10_timer_pmu_enabled);
+
+static SYSCTL_NODE(_hw, OID_AUTO, a10_timer, CTLFLAG_RD, 0,
+    "A10 timer");
+SYSCTL_INT(_hw_a10_timer, OID_AUTO, pmu, CTLFLAG_RDTUN,
+    &a10_timer_pmu_enabled, 0, "Register the PMU cycle counter timecounter");
+
 struct a10_timer_softc *a10_timer_sc = NULL;
 
 static struct resource_spec a10_timer_spec[] = {
 	{ SYS_RES_MEMORY,	0,	RF_ACTIVE },
-	{ SYS_RES_IRQ,		0,	RF_ACTIVE },
+	{ SYS_RES_IRQ,		0,	RF_ACTIVE },			/* timer0 */
+	{ SYS_RES_IRQ,		2,	RF_ACTIVE | RF_OPTIONAL },	/* timer2 */
+	{ SYS_RES_IRQ,		4,	RF_ACTIVE | RF_OPTIONAL },	/* timer4 */
 	{ -1, 0 }
 };
 
+static const struct {
+	int		timer;
+	const char	*name;
+	int		quality;
+} a10_timer_et_desc[A10_TIMER_ET_NUM] = {
+	{ 0,	"a10_timer Eventtimer",	1000 },
+	{ 2,	"a10_timer timer2",	100 },
+	{ 4,	"a10_timer timer4",	100 },
+};
+
 static uint64_t
 timer_read_counter64(void)
 {
@@ -137,6 +236,71 @@ timer_read_counter64(void)
 	return (((uint64_t)hi << 32) | lo);
 }
 
+static __inline uint32_t
+a10_pmu_read_ccnt(void)
+{
+	uint32_t ccnt;
+
+	__asm __volatile("mrc p15, 0, %0, c9, c13, 0" : "=r" (ccnt));
+
+	return (ccnt);
+}
+
+static void
+a10_pmu_init(struct a10_timer_softc *sc)
+{
+	uint32_t ccnt, first, now, pmcr;
+	uint64_t elapsed, ticks;
+
+	/* Start the cycle counter at full CPU clock. */
+	__asm __volatile("mrc p15, 0, %0, c9, c12, 0" : "=r" (pmcr));
+	pmcr |= PMCR_E | PMCR_C;
+	pmcr &= ~PMCR_D;
+	__asm __volatile("mcr p15, 0, %0, c9, c12, 0" : : "r" (pmcr));
+	__asm __volatile("mcr p15, 0, %0, c9, c12, 1" : : "r" (PMCNTEN_CCNT));
+
+	/* Calibrate it against OSC24M through timer1. */
+	ticks = (uint64_t)PMU_CALIBRATE_US * sc->timer1_ticks_per_us;
+	first = timer_read_4(sc, SW_TIMER1_CUR_VALUE_REG);
+	ccnt = a10_pmu_read_ccnt();
+	do {
+		now = timer_read_4(sc, SW_TIMER1_CUR_VALUE_REG);
+	} while ((uint32_t)(first - now) < ticks);
+	ccnt = a10_pmu_read_ccnt() - ccnt;
+	elapsed = first - now;
+
+	a10_pmu_timecounter.tc_frequency =
+	    (uint64_t)ccnt * sc->timer1_freq / elapsed;
+	tc_init(&a10_pmu_timecounter);
+
+	EVENTHANDLER_REGISTER(cpufreq_post_change, a10_pmu_freq_changed, NULL,
+	    EVENTHANDLER_PRI_ANY);
+}
+
+static void
+a10_pmu_freq_changed(void *arg, const struct cf_level *level, int status)
+{
+
+	/* If there was an error during the transition, don't do anything. */
+	if (status != 0)
+		return;
+
+	/* Total setting for this level gives the new frequency in MHz. */
+	a10_pmu_timecounter.tc_frequency =
+	    (uint64_t)level->total_set.freq * 1000000;
+}
+
+static void
+a10_timer_sync(struct a10_timer_softc *sc)
+{
+	uint32_t old;
+
+	old = timer_read_4(sc, SW_TIMER1_CUR_VALUE_REG);
+	while ((old - timer_read_4(sc, SW_TIMER1_CUR_VALUE_REG)) <
+	    TIMER_SYNC_TICKS)
+		continue;
+}
+
 static int
 a10_timer_probe(device_t dev)
 {
@@ -152,8 +316,7 @@ static int
 a10_timer_attach(device_t dev)
 {
 	struct a10_timer_softc *sc;
-	int err;
-	uint32_t val;
+	int err, i;
 
 	sc = device_get_softc(dev);
 
@@ -166,50 +329,49 @@ a10_timer_attach(device_t dev)
 	sc->sc_bst = rman_get_bustag(sc->res[0]);
 	sc->sc_bsh = rman_get_bushandle(sc->res[0]);
 
-	/* Setup and enable the timer interrupt */
-	err = bus_setup_intr(dev, sc->res[1], INTR_TYPE_CLK, a10_timer_hardclock,
-	    NULL, sc, &sc->sc_ih);
+	sc->timer0_freq = SYS_TIMER_CLKSRC >> TIMER_ET_PRESCALE;
+
+	/*
+	 * Timer1 runs free from OSC24M without pre-division and is never
+	 * stopped, it counts down from 0xffffffff and wraps around.
+	 */
+	timer_write_4(sc, SW_TIMER1_INT_VALUE_REG, ~0u);
+	timer_write_4(sc, SW_TIMER1_CTRL_REG,
+	    TIMER_OSC24M | TIMER_RELOAD | TIMER_ENABLE);
+
+	sc->timer1_freq = SYS_TIMER_CLKSRC;
+	sc->timer1_ticks_per_us = sc->timer1_freq / 1000000;
+
+	/* Timer0 is required, the spare event timers are optional */
+	err = a10_timer_et_attach(sc, 0);
 	if (err != 0) {
 		bus_release_resources(dev, a10_timer_spec, sc->res);
 		device_printf(dev, "Unable to setup the clock irq handler, "
 		    "err = %d\n", err);
 		return (ENXIO);
 	}
-
-	/* Set clock source to OSC24M, 16 pre-division */
-	val = timer_read_4(sc, SW_TIMER0_CTRL_REG);
-	val |= TIMER_PRESCALAR | TIMER_OSC24M;
-	timer_write_4(sc, SW_TIMER0_CTRL_REG, val);
-
-	/* Enable timer0 */
-	val = timer_read_4(sc, SW_TIMER_IRQ_EN_REG);
-	val |= TIMER_ENABLE;
-	timer_write_4(sc, SW_TIMER_IRQ_EN_REG, val);
-
-	sc->timer0_freq = SYS_TIMER_CLKSRC;
-
-	/* Set desired frequency in event timer and timecounter */
-	sc->et.et_frequency = sc->timer0_freq;
-	sc->et.et_name = "a10_timer Eventtimer";
-	sc->et.et_flags = ET_FLAGS_ONESHOT | ET_FLAGS_PERIODIC;
-	sc->et.et_quality = 1000;
-	sc->et.et_min_period.sec = 0;
-	sc->et.et_min_period.frac =
-	    ((0x00000005LLU << 32) / sc->et.et_frequency) << 32;
-	sc->et.et_max_period.sec = 0xfffffff0U / sc->et.et_frequency;
-	sc->et.et_max_period.frac =
-	    ((0xfffffffeLLU << 32) / sc->et.et_frequency) << 32;
-	sc->et.et_start = a10_timer_timer_start;
-	sc->et.et_stop = a10_timer_timer_stop;
-	sc->et.et_priv = sc;
-	et_register(&sc->et);
+	for (i = 1; i < A10_TIMER_ET_NUM; i++) {
+		if (sc->res[1 + i] == NULL)
+			continue;
+		err = a10_timer_et_attach(sc, i);
+		if (err != 0)
+			device_printf(dev, "Unable to setup timer%d irq "
+			    "handler, err = %d\n", a10_timer_et_desc[i].timer,
+			    err);
+	}
 
 	if (device_get_unit(dev) == 0)
 		a10_timer_sc = sc;
 
-	a10_timer_timecounter.tc_frequency = sc->timer0_freq;
+	a10_timer_timecounter.tc_frequency = SYS_TIMER_CLKSRC;
 	tc_init(&a10_timer_timecounter);
 
+	a10_timer1_timecounter.tc_frequency = sc->timer1_freq;
+	tc_init(&a10_timer1_timecounter);
+
+	if (a10_timer_pmu_enabled)
+		a10_pmu_init(sc);
+
 	if (bootverbose) {
 		device_printf(sc->sc_dev, "clock: hz=%d stathz = %d\n", hz, stathz);
 
@@ -217,6 +379,12 @@ a10_timer_attach(device_t dev)
 		    sc->timer0_freq);
 		device_printf(sc->sc_dev, "timecounter clock frequency %lld\n", 
 		    a10_timer_timecounter.tc_frequency);
+		device_printf(sc->sc_dev, "timer1 timecounter frequency %lld\n",
+		    a10_timer1_timecounter.tc_frequency);
+		if (a10_timer_pmu_enabled)
+			device_printf(sc->sc_dev,
+			    "PMU timecounter frequency %lld\n",
+			    a10_pmu_timecounter.tc_frequency);
 	}
 
 	a10_timer_initialized = 1;
@@ -224,45 +392,111 @@ a10_timer_attach(device_t dev)
 	return (0);
 }
 
+static int
+a10_timer_et_attach(struct a10_timer_softc *sc, int idx)
+{
+	struct a10_timer_et *tet;
+	int err, n;
+	uint32_t val;
+
+	tet = &sc->sc_et[idx];
+	n = a10_timer_et_desc[idx].timer;
+	tet->sc = sc;
+	tet->timer = n;
+
+	/* Setup and enable the timer interrupt */
+	err = bus_setup_intr(sc->sc_dev, sc->res[1 + idx], INTR_TYPE_CLK,
+	    a10_timer_hardclock, NULL, tet, &tet->ih);
+	if (err != 0)
+		return (err);
+
+	/* Set clock source to OSC24M, no pre-division, timer stopped */
+	val = timer_read_4(sc, SW_TIMER_CTRL_REG(n));
+	val &= ~(TIMER_CLKSRC_MASK | TIMER_PRESCALAR_MASK | TIMER_ONESHOT |
+	    TIMER_ENABLE);
+	val |= TIMER_PRESCALAR(TIMER_ET_PRESCALE) | TIMER_OSC24M;
+	timer_write_4(sc, SW_TIMER_CTRL_REG(n), val);
+
+	/* Enable the timer interrupt */
+	val = timer_read_4(sc, SW_TIMER_IRQ_EN_REG);
+	val |= (1 << n);
+	timer_write_4(sc, SW_TIMER_IRQ_EN_REG, val);
+
+	/* Set desired frequency in event timer */
+	tet->et.et_frequency = SYS_TIMER_CLKSRC >> TIMER_ET_PRESCALE;
+	tet->et.et_name = a10_timer_et_desc[idx].name;
+	tet->et.et_flags = ET_FLAGS_ONESHOT | ET_FLAGS_PERIODIC;
+	tet->et.et_quality = a10_timer_et_desc[idx].quality;
+	tet->et.et_min_period.sec = 0;
+	tet->et.et_min_period.frac =
+	    (((uint64_t)TIMER_MIN_TICKS << 32) / tet->et.et_frequency) << 32;
+	tet->et.et_max_period.sec = 0xfffffff0U / tet->et.et_frequency;
+	tet->et.et_max_period.frac =
+	    ((0xfffffffeLLU << 32) / tet->et.et_frequency) << 32;
+	tet->et.et_start = a10_timer_timer_start;
+	tet->et.et_stop = a10_timer_timer_stop;
+	tet->et.et_priv = tet;
+	et_register(&tet->et);
+
+	return (0);
+}
+
 static int
 a10_timer_timer_start(struct eventtimer *et, struct bintime *first,
     struct bintime *period)
 {
 	struct a10_timer_softc *sc;
-	uint32_t count;
+	struct a10_timer_et *tet;
+	uint32_t count, interval;
 	uint32_t val;
 
-	sc = (struct a10_timer_softc *)et->et_priv;
-
-	sc->sc_period = 0;
+	tet = (struct a10_timer_et *)et->et_priv;
+	sc = tet->sc;
 
+	interval = 0;
 	if (period != NULL) {
-		sc->sc_period = (sc->et.et_frequency * (period->frac >> 32)) >> 32;
-		sc->sc_period += sc->et.et_frequency * period->sec;
+		interval = (et->et_frequency * (period->frac >> 32)) >> 32;
+		interval += et->et_frequency * period->sec;
+		if (interval < TIMER_MIN_TICKS)
+			interval = TIMER_MIN_TICKS;
 	}
 	if (first == NULL)
-		count = sc->sc_period;
+		count = interval;
 	else {
-		count = (sc->et.et_frequency * (first->frac >> 32)) >> 32;
+		count = (et->et_frequency * (first->frac >> 32)) >> 32;
 		if (first->sec != 0)
-			count += sc->et.et_frequency * first->sec;
+			count += et->et_frequency * first->sec;
+		if (count < TIMER_MIN_TICKS)
+			count = TIMER_MIN_TICKS;
 	}
 
-	/* Update timer values */
-	timer_write_4(sc, SW_TIMER0_INT_VALUE_REG, sc->sc_period);
-	timer_write_4(sc, SW_TIMER0_CUR_VALUE_REG, count);
-
-	val = timer_read_4(sc, SW_TIMER0_CTRL_REG);
-	if (first == NULL) {
-		/* periodic */
-		val |= TIMER_AUTORELOAD;
-	} else {
-		/* oneshot */
-		val &= ~TIMER_AUTORELOAD;
+	/* Stop the timer before reloading it */
+	val = timer_read_4(sc, SW_TIMER_CTRL_REG(tet->timer));
+	val &= ~(TIMER_ENABLE | TIMER_ONESHOT);
+	timer_write_4(sc, SW_TIMER_CTRL_REG(tet->timer), val);
+	a10_timer_sync(sc);
+
+	/* Drop an expiry left pending by the previous programming */
+	timer_write_4(sc, SW_TIMER_IRQ_STA_REG, (1 << tet->timer));
+
+	timer_write_4(sc, SW_TIMER_INT_VALUE_REG(tet->timer), count);
+	if (period == NULL)
+		val |= TIMER_ONESHOT;
+
+	/* Load the first interval and enable the timer */
+	val |= TIMER_RELOAD | TIMER_ENABLE;
+	timer_write_4(sc, SW_TIMER_CTRL_REG(tet->timer), val);
+
+	/*
+	 * In continuous mode the interval register is reloaded on every
+	 * expiry, so once the first count has been loaded it can be
+	 * replaced by the period.
+	 */
+	if (period != NULL && count != interval) {
+		a10_timer_sync(sc);
+		timer_write_4(sc, SW_TIMER_INT_VALUE_REG(tet->timer),
+		    interval);
 	}
-	/* Enable timer0 */
-	val |= TIMER_ENABLE;
-	timer_write_4(sc, SW_TIMER0_CTRL_REG, val);
 
 	return (0);
 }
@@ -271,16 +505,17 @@ static int
 a10_timer_timer_stop(struct eventtimer *et)
 {
 	struct a10_timer_softc *sc;
+	struct a10_timer_et *tet;
 	uint32_t val;
 
-	sc = (struct a10_timer_softc *)et->et_priv;
+	tet = (struct a10_timer_et *)et->et_priv;
+	sc = tet->sc;
 
-	/* Disable timer0 */
-	val = timer_read_4(sc, SW_TIMER0_CTRL_REG);
+	/* Disable the timer */
+	val = timer_read_4(sc, SW_TIMER_CTRL_REG(tet->timer));
 	val &= ~TIMER_ENABLE;
-	timer_write_4(sc, SW_TIMER0_CTRL_REG, val);
-
-	sc->sc_period = 0;
+	timer_write_4(sc, SW_TIMER_CTRL_REG(tet->timer), val);
+	a10_timer_sync(sc);
 
 	return (0);
 }
@@ -300,32 +535,15 @@ cpu_initclocks(void)
 static int
 a10_timer_hardclock(void *arg)
 {
-	struct a10_timer_softc *sc;
-	uint32_t val;
+	struct a10_timer_et *tet;
 
-	sc = (struct a10_timer_softc *)arg;
+	tet = (struct a10_timer_et *)arg;
 
 	/* Clear interrupt pending bit. */
-	timer_write_4(sc, SW_TIMER_IRQ_STA_REG, 0x1);
+	timer_write_4(tet->sc, SW_TIMER_IRQ_STA_REG, (1 << tet->timer));
 
-	val = timer_read_4(sc, SW_TIMER0_CTRL_REG);
-	/*
-	 * Disabled autoreload and sc_period > 0 means 
-	 * timer_start was called with non NULL first value.
-	 * Now we will set periodic timer with the given period 
-	 * value.
-	 */
-	if ((val & (1<<1)) == 0 && sc->sc_period > 0) {
-		/* Update timer */
-		timer_write_4(sc, SW_TIMER0_CUR_VALUE_REG, sc->sc_period);
-
-		/* Make periodic and enable */
-		val |= TIMER_AUTORELOAD | TIMER_ENABLE;
-		timer_write_4(sc, SW_TIMER0_CTRL_REG, val);
-	}
-
-	if (sc->et.et_active)
-		sc->et.et_event_cb(&sc->et, sc->et.et_arg);
+	if (tet->et.et_active)
+		tet->et.et_event_cb(&tet->et, tet->et.et_arg);
 
 	return (FILTER_HANDLED);
 }
@@ -340,6 +558,24 @@ a10_timer_get_timecount(struct timecounter *tc)
 	return ((u_int)timer_read_counter64());
 }
 
+static u_int
+a10_timer1_get_timecount(struct timecounter *tc)
+{
+
+	if (a10_timer_sc == NULL)
+		return (0);
+
+	/* Timer1 counts down, timecounters are expected to count up. */
+	return (~timer_read_4(a10_timer_sc, SW_TIMER1_CUR_VALUE_REG));
+}
+
+static u_int
+a10_pmu_get_timecount(struct timecounter *tc)
+{
+
+	return (a10_pmu_read_ccnt());
+}
+
 static device_method_t a10_timer_methods[] = {
 	DEVMETHOD(device_probe,		a10_timer_probe),
 	DEVMETHOD(device_attach,	a10_timer_attach),
@@ -361,7 +597,8 @@ void
 DELAY(int usec)
 {
 	uint32_t counter;
-	uint64_t end, now;
+	uint32_t delta, last, now;
+	uint64_t ticks;
 
 	if (!a10_timer_initialized) {
 		for (; usec > 0; usec--)
@@ -370,10 +607,23 @@ DELAY(int usec)
 		return;
 	}
 
-	now = timer_read_counter64();
-	end = now + (a10_timer_sc->timer0_freq / 1000000) * (usec + 1);
+	if (usec <= 0)
+		return;
 
-	while (now < end)
-		now = timer_read_counter64();
+	/*
+	 * Count elapsed ticks of the free-running timer1 rather than
+	 * latching the 64-bit counter, that is a single register read
+	 * per iteration.  Timer1 counts down, hence last - now.
+	 */
+	ticks = (uint64_t)(usec + 1) * a10_timer_sc->timer1_ticks_per_us;
+	last = timer_read_4(a10_timer_sc, SW_TIMER1_CUR_VALUE_REG);
+
+	while (ticks > 0) {
+		now = timer_read_4(a10_timer_sc, SW_TIMER1_CUR_VALUE_REG);
+		delta = last - now;
+		last = now;
+		if (delta >= ticks)
+			break;
+		ticks -= delta;
+	}
 }
-
@@ -0,0 +1,180 @@
+/*-
+ * Copyright (c) 2026 agent <agent@local>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Time clock_gettime(2) with each timecounter in kern.timecounter.choice
+ * selected in turn, to compare their cost on the board.  Needs root to
+ * switch kern.timecounter.hardware; the original one is put back.
+ */
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include <sys/types.h>
+#include <sys/sysctl.h>
+
+#include <err.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define	TC_HARDWARE	"kern.timecounter.hardware"
+#define	TC_CHOICE	"kern.timecounter.choice"
+
+static char orig[64];
+
+static char *
+get_string(const char *name)
+{
+	size_t len;
+	char *buf;
+
+	if (sysctlbyname(name, NULL, &len, NULL, 0) != 0)
+		err(1, "%s", name);
+	if ((buf = malloc(len)) == NULL)
+		err(1, "malloc");
+	if (sysctlbyname(name, buf, &len, NULL, 0) != 0)
+		err(1, "%s", name);
+	return (buf);
+}
+
+static int
+set_hardware(const char *name)
+{
+
+	return (sysctlbyname(TC_HARDWARE, NULL, NULL, name, strlen(name) + 1));
+}
+
+static void
+restore(int sig)
+{
+
+	set_hardware(orig);
+	_exit(128 + sig);
+}
+
+static double
+bench(long count)
+{
+	struct timespec start, end, ts;
+	long i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++)
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (((end.tv_sec - start.tv_sec) * 1e9 +
+	    (end.tv_nsec - start.tv_nsec)) / count);
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "usage: a10_tcbench [-n count]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	char *choice, *name, *p, *q, *end;
+	double ns;
+	long count, quality;
+	int ch, error;
+
+	count = 1000000;
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			count = strtol(optarg, &end, 0);
+			if (*end != '\0' || count <= 0)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc != optind)
+		usage();
+
+	p = get_string(TC_HARDWARE);
+	strlcpy(orig, p, sizeof(orig));
+	free(p);
+	choice = get_string(TC_CHOICE);
+	signal(SIGINT, restore);
+	signal(SIGTERM, restore);
+
+	/*
+	 * The list is "name(quality) name(quality) ...", and the names
+	 * themselves may contain spaces ("a10_timer timer1").
+	 */
+	printf("%-24s %8s %12s %12s\n", "timecounter", "quality", "ns/call",
+	    "calls/s");
+	error = 0;
+	for (name = choice; *name != '\0'; name = q + 1) {
+		while (*name == ' ')
+			name++;
+		if ((p = strchr(name, '(')) == NULL ||
+		    (q = strchr(p, ')')) == NULL)
+			break;
+		*p = '\0';
+		quality = strtol(p + 1, NULL, 10);
+		/*
+		 * Negative quality only keeps a counter from being picked
+		 * automatically (the PMU cycle counter is -100); dummy is
+		 * the one that does not count at all.
+		 */
+		if (strcmp(name, "dummy") == 0) {
+			if (*(q + 1) == '\0')
+				break;
+			continue;
+		}
+		if (set_hardware(name) != 0) {
+			warn("%s", name);
+			error = 1;
+		} else {
+			/* The switch takes effect at the next tc_windup() */
+			usleep(100000);
+			ns = bench(count);
+			printf("%-24s %8ld %12.1f %12.0f\n", name, quality, ns,
+			    1e9 / ns);
+		}
+		if (*(q + 1) == '\0')
+			break;
+	}
+
+	if (set_hardware(orig) != 0)
+		err(1, "restoring %s", orig);
+	free(choice);
+
+	return (error);
+}